@@ -0,0 +1,595 @@
+#include "EarthquakeService.h"
+#include "QuakeStats.h"
+#include "QuakeJson.h"
+#include "QuakeBinary.h"
+#include "Gzip.h"
+#include "Metrics.h"
+#include "QuakeIndex.h"
+#include "QuakeAggregates.h"
+#include "EventStream.h"
+#include "httplib.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Core benchmarks on a fixed fixture. Without a file argument the fixture
+// is generated from a fixed seed in the USGS feed schema, so numbers are
+// comparable across commits. Each case reports median and min wall time.
+
+namespace {
+
+struct Options {
+    std::string fixturePath;
+    int count = 10000;
+    int iterations = 30;
+    int port = 18089;
+    int clients = 8;
+    int requests = 500;     // per client
+    int streamPort = 18090;
+    int streamClients = 1000;
+    int streamEvents = 100;
+};
+
+// Small deterministic PRNG (no dependence on the standard library's engines)
+struct Rng {
+    uint64_t state;
+    explicit Rng(uint64_t seed) : state(seed) {}
+    uint32_t Next() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (uint32_t)(state >> 33);
+    }
+    double Uniform() { return (Next() + 0.5) / 2147483648.0; }
+    template <typename T, size_t N> const T& Pick(const T (&items)[N]) { return items[Next() % N]; }
+};
+
+std::string MakeFixture(int count) {
+    static const char* regions[] = {
+        "CA", "Alaska", "Hawaii", "Nevada", "Puerto Rico", "Japan", "Indonesia", "Chile", "Mexico",
+        "Philippines", "Tonga", "Papua New Guinea", "Fiji region", "Peru", "Greece", "Turkey", "New Zealand",
+        "Iceland", "Italy", "off the coast of Oregon", "Kermadec Islands region", "Mid-Atlantic Ridge"
+    };
+    static const char* directions[] = {"N", "NNE", "NE", "E", "SE", "S", "SW", "W", "NW", "WNW"};
+    static const char* towns[] = {"Pahala", "Ridgecrest", "Anchorage", "Ponce", "Hualien", "Coquimbo", "Ohira", "Bitung"};
+    static const char* nets[] = {"ak", "ci", "hv", "nc", "nn", "pr", "us", "uw"};
+
+    Rng rng(20240601);
+    const long long end = 1717200000000LL;
+    std::string out;
+    out.reserve((size_t)count * 900);
+    out += "{\"type\":\"FeatureCollection\",\"metadata\":{\"generated\":" + std::to_string(end) +
+           ",\"url\":\"https://earthquake.usgs.gov/earthquakes/feed/v1.0/summary/all_day.geojson\","
+           "\"title\":\"USGS All Earthquakes, Past Day\",\"status\":200,\"api\":\"1.10.3\",\"count\":" +
+           std::to_string(count) + "},\"features\":[";
+
+    char buf[4096];
+    for (int i = 0; i < count; i++) {
+        // Roughly Gutenberg-Richter: many small events, few large ones
+        double mag = std::min(8.5, -std::log10(rng.Uniform()) * 1.1);
+        std::string place = std::to_string(1 + rng.Next() % 120) + " km " + rng.Pick(directions) + " of " +
+                            rng.Pick(towns) + ", " + rng.Pick(regions);
+        long long time = end - (long long)(rng.Uniform() * 86400000.0);
+        double lon = rng.Uniform() * 360.0 - 180.0;
+        double lat = rng.Uniform() * 160.0 - 80.0;
+        double depth = rng.Uniform() * 120.0;
+        const char* net = rng.Pick(nets);
+        char id[32];
+        std::snprintf(id, sizeof(id), "%s%08u", net, rng.Next() % 100000000u);
+
+        int n = std::snprintf(buf, sizeof(buf),
+            "%s{\"type\":\"Feature\",\"properties\":{\"mag\":%.2f,\"place\":\"%s\",\"time\":%lld,\"updated\":%lld,"
+            "\"tz\":null,\"url\":\"https://earthquake.usgs.gov/earthquakes/eventpage/%s\","
+            "\"detail\":\"https://earthquake.usgs.gov/earthquakes/feed/v1.0/detail/%s.geojson\",\"felt\":null,"
+            "\"cdi\":null,\"mmi\":null,\"alert\":null,\"status\":\"automatic\",\"tsunami\":0,\"sig\":%d,\"net\":\"%s\","
+            "\"code\":\"%s\",\"ids\":\",%s,\",\"sources\":\",%s,\",\"types\":\",origin,phase-data,\",\"nst\":%u,"
+            "\"dmin\":%.3f,\"rms\":%.2f,\"gap\":%u,\"magType\":\"ml\",\"type\":\"earthquake\",\"title\":\"M %.1f - %s\"},"
+            "\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.4f,%.4f,%.2f]},\"id\":\"%s\"}",
+            i ? "," : "", mag, place.c_str(), time, time + 60000, id, id, (int)(mag * mag * 10), net,
+            id + 2, id, net, 5 + rng.Next() % 60, rng.Uniform(), rng.Uniform(), 30 + rng.Next() % 200,
+            mag, place.c_str(), lon, lat, depth, id);
+        out.append(buf, (size_t)std::min(n, (int)sizeof(buf) - 1));
+    }
+    out += "],\"bbox\":[-180,-80,0,180,80,120]}";
+    return out;
+}
+
+bool ReadFile(const std::string& path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::stringstream ss;
+    ss << in.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+uint64_t g_sink = 0;   // results fold in here so no case is optimized away
+
+// Sorted wall times of `iterations` runs after one warm-up
+std::vector<double> Time(int iterations, const std::function<uint64_t()>& fn) {
+    g_sink += fn();
+    std::vector<double> ms;
+    ms.reserve((size_t)iterations);
+    for (int i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        g_sink += fn();
+        ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(ms.begin(), ms.end());
+    return ms;
+}
+
+void Run(const char* name, int iterations, const std::function<uint64_t()>& fn) {
+    std::vector<double> ms = Time(iterations, fn);
+    std::printf("%-28s %10.3f %10.3f %6d\n", name, ms[ms.size() / 2], ms.front(), iterations);
+}
+
+// Full-set body in each negotiable format: server-side encode (document
+// build included), payload size, what a client spends decoding it, and the
+// one-off cost and size of its gzip copy
+void RunFormats(const char* name, int iterations, const std::vector<Earthquake>& quakes) {
+    QuakeSnapshot snapshot;
+    snapshot.version = 1;
+    snapshot.quakes = quakes;
+
+    std::printf("\n%-28s %10s %10s %10s %10s %10s   (%zu events)\n", name, "encode ms", "bytes", "decode ms",
+                "gzip ms", "gz bytes", quakes.size());
+    const QuakeBinary::Format formats[] = {QuakeBinary::Format::Json, QuakeBinary::Format::Cbor, QuakeBinary::Format::MsgPack};
+    for (auto format : formats) {
+        std::string body;
+        double encode = Time(iterations, [&] {
+            body = format == QuakeBinary::Format::Json ? QuakeJson::FullSync(snapshot, 0)
+                                                       : QuakeBinary::Encode(QuakeBinary::FullSync(snapshot, 0), format);
+            return (uint64_t)body.size();
+        })[(size_t)iterations / 2];
+        double decode = Time(iterations, [&] {
+            nlohmann::json doc = format == QuakeBinary::Format::Json ? nlohmann::json::parse(body)
+                               : format == QuakeBinary::Format::Cbor ? nlohmann::json::from_cbor(body)
+                                                                     : nlohmann::json::from_msgpack(body);
+            return (uint64_t)doc["quakes"].size();
+        })[(size_t)iterations / 2];
+        std::string packed;
+        double gzip = Time(iterations, [&] {
+            packed = Gzip::Compress(body);
+            return (uint64_t)packed.size();
+        })[(size_t)iterations / 2];
+        std::printf("  %-26s %10.3f %10zu %10.3f %10.3f %10zu\n", QuakeBinary::ContentType(format), encode, body.size(),
+                    decode, gzip, packed.size());
+    }
+}
+
+bool ParseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--count") && hasValue) opt.count = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--iterations") && hasValue) opt.iterations = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--port") && hasValue) opt.port = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--clients") && hasValue) opt.clients = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--requests") && hasValue) opt.requests = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--stream-port") && hasValue) opt.streamPort = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--stream-clients") && hasValue) opt.streamClients = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--stream-events") && hasValue) opt.streamEvents = std::atoi(argv[++i]);
+        else if (argv[i][0] != '-' && opt.fixturePath.empty()) opt.fixturePath = argv[i];
+        else return false;
+    }
+    return opt.count > 0 && opt.iterations > 0 && opt.clients > 0 && opt.requests > 0 &&
+           opt.streamClients >= 0 && opt.streamEvents > 0;
+}
+
+#ifndef _WIN32
+// Idle SSE subscribers on raw sockets; one publish of `streamEvents` inserts,
+// timed until every subscriber has received all of them.
+void RunStreamFanOut(const Options& opt, const std::vector<Earthquake>& quakes) {
+    rlimit lim{};
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    EventStreamServer server;
+    if (!server.start(opt.streamPort)) return;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)opt.streamPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const char* request = "GET /events/stream HTTP/1.1\r\nHost: localhost\r\nAccept: text/event-stream\r\n\r\n";
+
+    std::vector<pollfd> fds;
+    for (int i = 0; i < opt.streamClients; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            if (fd >= 0) close(fd);
+            std::printf("stream fan-out: only %d clients connected\n", i);
+            break;
+        }
+        (void)!send(fd, request, std::strlen(request), 0);
+        fds.push_back({fd, POLLIN, 0});
+    }
+
+    // Every message ends in a blank line; the first one is the "retry:" preamble
+    std::vector<int> messages(fds.size(), 0);
+    std::vector<char> lastChar(fds.size(), 0);
+    size_t bytes = 0;
+    auto readUntil = [&](int target, double timeoutSec) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeoutSec);
+        size_t done = 0;
+        char buf[65536];
+        while (done < fds.size() && std::chrono::steady_clock::now() < deadline) {
+            if (poll(fds.data(), (nfds_t)fds.size(), 100) <= 0) continue;
+            done = 0;
+            for (size_t i = 0; i < fds.size(); i++) {
+                if (fds[i].revents & POLLIN) {
+                    ssize_t n = recv(fds[i].fd, buf, sizeof(buf), 0);
+                    for (ssize_t k = 0; k < n; k++) {
+                        if (buf[k] == '\n' && lastChar[i] == '\n') messages[i]++;
+                        lastChar[i] = buf[k];
+                    }
+                    if (n > 0) bytes += (size_t)n;
+                }
+                if (messages[i] >= target) done++;
+            }
+        }
+        return done;
+    };
+    readUntil(1, 10.0);
+
+    auto snapshot = std::make_shared<QuakeSnapshot>();
+    snapshot->version = 1;
+    for (int i = 0; i < opt.streamEvents && i < (int)quakes.size(); i++) snapshot->changes.inserted.push_back(quakes[(size_t)i]);
+    int expected = 1 + (int)snapshot->changes.inserted.size();
+
+    bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    server.publish(snapshot);
+    size_t complete = readUntil(expected, 30.0);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("\n%-28s %8s %8s %10s %10s\n", "event stream fan-out", "clients", "events", "all ms", "MB/s");
+    std::printf("%-28s %8zu %8d %10.2f %10.1f\n", "/events/stream", complete, expected - 1, ms, bytes / 1048576.0 / (ms / 1000.0));
+
+    for (auto& p : fds) close(p.fd);
+    server.stop();
+}
+#endif
+
+double Percentile(std::vector<double>& sorted, double q) {
+    return sorted[std::min(sorted.size() - 1, (size_t)(q * (double)(sorted.size() - 1) + 0.5))];
+}
+
+// Concurrent keep-alive clients against a local API server. Each client
+// cycles through `paths`; reports latency percentiles and throughput.
+void RunLoad(const char* name, const Options& opt, const std::vector<std::string>& paths,
+             const httplib::Headers& headers = {}) {
+    std::vector<std::vector<double>> perClient((size_t)opt.clients);
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < opt.clients; c++) {
+        threads.emplace_back([&, c] {
+            httplib::Client cli("127.0.0.1", opt.port);
+            cli.set_keep_alive(true);
+            cli.set_tcp_nodelay(true);
+            auto& lat = perClient[(size_t)c];
+            lat.reserve((size_t)opt.requests);
+            for (int r = 0; r < opt.requests; r++) {
+                const std::string& path = paths[(size_t)(c + r) % paths.size()];
+                auto t0 = std::chrono::steady_clock::now();
+                auto res = cli.Get(path, headers);
+                lat.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+                if (!res || (res->status != 200 && res->status != 304)) failures++;
+                else g_sink += res->body.size();
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> all;
+    for (auto& v : perClient) all.insert(all.end(), v.begin(), v.end());
+    std::sort(all.begin(), all.end());
+    std::printf("%-28s %8.3f %8.3f %8.3f %10.0f %6d\n", name, Percentile(all, 0.50), Percentile(all, 0.99),
+                all.back(), (double)all.size() / seconds, failures.load());
+}
+
+// Median latency of `n` sequential calls
+double MedianMs(int n, const std::function<void()>& fn) {
+    std::vector<double> ms;
+    for (int i = 0; i < n; i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+    }
+    std::sort(ms.begin(), ms.end());
+    return Percentile(ms, 0.5);
+}
+
+// Admission control under a flood: clients hammer a heavy query (all from
+// 127.0.0.1, so they share one token bucket) while /status and publish()
+// are timed. Prints one row for the idle server and one under the flood.
+void RunFlood(const char* name, const Options& opt, const std::vector<Earthquake>& quakes, const ApiServerConfig& config) {
+    EarthquakeService service;
+    service.publish(quakes);
+    int port = opt.port + 2;
+    service.startAPIServer(port, config);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<Earthquake> next = quakes;
+    int step = 0;
+    httplib::Client probe("127.0.0.1", port);
+    probe.set_keep_alive(true);
+    auto timeStatus = [&] {
+        return MedianMs(50, [&] { auto res = probe.Get("/status"); g_sink += res && res->status == 200 ? res->body.size() : 1000000; });
+    };
+    auto timePublish = [&] {
+        return MedianMs(5, [&] {
+            for (size_t i = (size_t)step++; i < next.size(); i += 100) next[i].mag += 0.1;
+            service.publish(next);
+        });
+    };
+    double idleStatus = timeStatus(), idlePublish = timePublish();
+
+    std::atomic<bool> flooding{true};
+    std::atomic<int> ok{0}, limited{0}, busy{0};
+    std::vector<std::thread> threads;
+    for (int c = 0; c < opt.clients; c++) {
+        threads.emplace_back([&] {
+            httplib::Client cli("127.0.0.1", port);
+            cli.set_keep_alive(true);
+            while (flooding) {
+                auto res = cli.Get("/quakes?limit=5000&sort=-mag");
+                if (!res) continue;
+                if (res->status == 200) ok++;
+                else if (res->status == 429) limited++;
+                else if (res->status == 503) busy++;
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(1));   // past the burst
+    double floodStatus = timeStatus(), floodPublish = timePublish();
+    flooding = false;
+    for (auto& t : threads) t.join();
+    service.stopService();
+
+    std::printf("%-28s %8.3f %8.3f %8.3f %8.3f %8d %8d %8d\n", name, idleStatus, floodStatus, idlePublish, floodPublish,
+                ok.load(), limited.load(), busy.load());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!ParseArgs(argc, argv, opt)) {
+        std::cout << "Usage: " << argv[0] << " [fixture.geojson] [--count N] [--iterations N]" << std::endl;
+        return 1;
+    }
+
+    std::string body;
+    if (!opt.fixturePath.empty()) {
+        if (!ReadFile(opt.fixturePath, body)) { std::cerr << "Cannot read " << opt.fixturePath << std::endl; return 1; }
+    } else {
+        body = MakeFixture(opt.count);
+    }
+
+    std::vector<Earthquake> quakes = EarthquakeService::parseGeoJSON(body);
+    std::vector<std::string> regions;
+    for (const auto& q : quakes) regions.push_back(QuakeStats::ExtractRegion(q.place));
+
+    std::printf("fixture: %s, %zu bytes, %zu events\n\n",
+                opt.fixturePath.empty() ? "generated" : opt.fixturePath.c_str(), body.size(), quakes.size());
+    std::printf("%-28s %10s %10s %6s\n", "case", "median ms", "min ms", "iters");
+
+    Run("parse geojson", opt.iterations, [&] {
+        return (uint64_t)EarthquakeService::parseGeoJSON(body).size();
+    });
+
+    Run("extract regions", opt.iterations, [&] {
+        uint64_t n = 0;
+        for (const auto& q : quakes) n += QuakeStats::ExtractRegion(q.place).size();
+        return n;
+    });
+
+    Run("filter mag>=1 + search", opt.iterations, [&] {
+        std::vector<Earthquake> out;
+        for (const auto& q : quakes) {
+            if (q.mag >= 1.0 && QuakeStats::ContainsCaseInsensitive(q.place, "of")) out.push_back(q);
+        }
+        return (uint64_t)out.size();
+    });
+
+    Run("region stats + sort", opt.iterations, [&] {
+        auto stats = QuakeStats::ByRegion(quakes, regions);
+        std::sort(stats.begin(), stats.end(), [](auto& a, auto& b) { return a.count > b.count; });
+        return (uint64_t)stats.size();
+    });
+
+    Run("magnitude histogram", opt.iterations, [&] {
+        float bins[QuakeStats::HistogramBins];
+        return (uint64_t)QuakeStats::MagnitudeHistogram(quakes, bins);
+    });
+
+    QuakeSnapshot snapshot;
+    snapshot.version = 1;
+    snapshot.quakes = quakes;
+    Run("serialize /status", opt.iterations, [&] {
+        return (uint64_t)QuakeJson::Status(snapshot).size();
+    });
+
+    std::vector<const Earthquake*> all;
+    for (const auto& q : quakes) all.push_back(&q);
+    Run("serialize all quakes json", opt.iterations, [&] {
+        std::string out;
+        QuakeJson::AppendArray(out, all);
+        return (uint64_t)out.size();
+    });
+
+    auto index = std::make_shared<QuakeIndex>(quakes);
+    QuakeQuery recent;
+    for (const auto& q : quakes) recent.startMs = std::max(recent.startMs, q.time_ms - 3600000);
+    Run("index build", opt.iterations, [&] {
+        return (uint64_t)QuakeIndex(quakes).Query(quakes, QuakeQuery()).total;
+    });
+    Run("index query (1 h, -time)", opt.iterations, [&] {
+        return (uint64_t)index->Query(quakes, recent).total;
+    });
+
+    // Instrumentation cost: 1M records into this thread's shard
+    auto benchCounter = Metrics::GetCounter("earthquake_bench_counter_total", "Benchmark only");
+    auto benchHistogram = Metrics::GetHistogram("earthquake_bench_seconds", "Benchmark only");
+    Run("metrics counter add x1M", opt.iterations, [&] {
+        for (int i = 0; i < 1000000; i++) benchCounter.Add();
+        return (uint64_t)1;
+    });
+    Run("metrics histogram obs x1M", opt.iterations, [&] {
+        for (int i = 0; i < 1000000; i++) benchHistogram.Observe(i * 1e-8);
+        return (uint64_t)1;
+    });
+
+    // USGS all_day carries a few hundred events, all_month about ten thousand
+    std::vector<Earthquake> day(quakes.begin(), quakes.begin() + (ptrdiff_t)std::min<size_t>(300, quakes.size()));
+    RunFormats("formats, day", opt.iterations, day);
+    RunFormats("formats, month", opt.iterations, quakes);
+    std::printf("\n");
+
+    // Delta sync: 16 publishes that each touch ~0.5% of the events
+    EarthquakeService history;
+    history.publish(quakes);
+    {
+        std::vector<Earthquake> next = quakes;
+        for (int v = 0; v < 16; v++) {
+            for (size_t i = (size_t)v; i < next.size(); i += 200) next[i].mag += 0.1;
+            history.publish(next);
+        }
+    }
+    auto latest = history.getSnapshot();
+    size_t deltaBytes = 0;
+    Run("changes since (16 versions)", opt.iterations, [&] {
+        QuakeChangeSet changes;
+        history.getChangesSince(1, latest->version, changes);
+        deltaBytes = QuakeJson::Changes(*latest, 0, 1, changes).size();
+        return (uint64_t)deltaBytes;
+    });
+    std::printf("%-28s %10zu %10zu   (delta / full bytes)\n", "", deltaBytes, QuakeJson::FullSync(*latest, 0).size());
+
+    // /stats aggregates: one publish's worth of updates (~0.5% of the
+    // events) applied and undone, vs. re-binning the totals per request
+    QuakeAggregator aggregator;
+    {
+        QuakeChangeSet all;
+        all.inserted = quakes;
+        aggregator.Apply(all);
+    }
+    QuakeChangeSet forward, back;
+    for (size_t i = 0; i < quakes.size(); i += 200) {
+        back.updated.push_back(quakes[i]);
+        forward.updated.push_back(quakes[i]);
+        forward.updated.back().mag += 0.1;
+    }
+    Run("aggregates update (0.5%)", opt.iterations, [&] {
+        aggregator.Apply(forward);
+        aggregator.Apply(back);
+        return (uint64_t)aggregator.Publish()->total;
+    });
+    auto aggregates = aggregator.Publish();
+    Run("stats hist + top 3 + rate", opt.iterations, [&] {
+        return (uint64_t)(aggregates->Histogram(5).size() + aggregates->TopRegions(false, 3).size() +
+                          aggregates->Rate(3600000, 0, LLONG_MAX).size());
+    });
+
+    // --- API under concurrent load ---
+    EarthquakeService service;
+    service.publish(quakes);
+    ApiServerConfig unlimited;
+    unlimited.clientRate = 0;       // every load client shares 127.0.0.1
+    unlimited.maxInFlight = 0;
+    service.startAPIServer(opt.port, unlimited);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::printf("\n%-28s %8s %8s %8s %10s %6s   (%d clients x %d requests)\n", "endpoint", "p50 ms", "p99 ms",
+                "max ms", "req/s", "fail", opt.clients, opt.requests);
+    RunLoad("/status", opt, {"/status"});
+    {
+        // Dashboard-style revalidation: every poll carries the current tag
+        httplib::Client cli("127.0.0.1", opt.port);
+        auto res = cli.Get("/status");
+        std::string etag = res ? res->get_header_value("ETag") : "";
+        RunLoad("/status If-None-Match", opt, {"/status"}, {{"If-None-Match", etag}});
+    }
+    RunLoad("/quakes mixed", opt, {
+        "/quakes?minmag=4.5",
+        "/quakes?sort=-mag&limit=20",
+        "/quakes?bbox=-125,32,-114,42&minmag=1",
+        "/quakes?lat=35.7&lon=139.7&radius=500",
+        "/quakes?place=alaska&limit=50&offset=50",
+        "/quakes?minmag=2&maxmag=3&sort=time&limit=200",
+    });
+    RunLoad("/stats mixed", opt, {
+        "/stats/histogram?width=0.5",
+        "/stats/regions?limit=3",
+        "/stats/regions?sort=mag&limit=3",
+        "/stats/rate?bucket=3600",
+    });
+    {
+        // Burst of connections past the worker pool: the excess waits in the
+        // queue or is refused with 503 (counted as failures), never hangs
+        Options spike = opt;
+        spike.clients = opt.clients * 8;
+        spike.requests = std::max(1, opt.requests / 10);
+        char name[64];
+        std::snprintf(name, sizeof(name), "/status spike (%d clients)", spike.clients);
+        RunLoad(name, spike, {"/status"});
+    }
+    {
+        // Whole-set export, streamed in chunks: first byte vs. last byte
+        httplib::Client cli("127.0.0.1", opt.port);
+        auto start = std::chrono::steady_clock::now();
+        double firstMs = -1;
+        size_t bytes = 0;
+        cli.Get("/quakes?limit=1000000", [&](const char*, size_t n) {
+            if (firstMs < 0) firstMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            bytes += n;
+            return true;
+        });
+        double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%-28s %8.3f %8.3f %10zu bytes   (first byte / last byte ms)\n", "/quakes export (streamed)", firstMs, totalMs, bytes);
+    }
+    service.stopService();
+
+    std::printf("\n%-28s %8s %8s %8s %8s %8s %8s %8s   (%d clients flooding)\n", "admission control", "status", "flooded",
+                "publish", "flooded", "200", "429", "503", opt.clients);
+    RunFlood("unlimited", opt, quakes, unlimited);
+    {
+        ApiServerConfig limited;
+        limited.clientRate = 20;
+        limited.clientBurst = 20;
+        limited.maxInFlight = 2;
+        RunFlood("20 req/s, 2 in flight", opt, quakes, limited);
+    }
+
+#ifndef _WIN32
+    if (opt.streamClients > 0) RunStreamFanOut(opt, quakes);
+#endif
+
+    std::printf("\nchecksum %llu\n", (unsigned long long)g_sink);
+    return 0;
+}
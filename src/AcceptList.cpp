@@ -0,0 +1,48 @@
+#include "AcceptList.h"
+#include <cctype>
+#include <cstdlib>
+
+namespace {
+
+std::string Trim(const std::string& s, size_t b, size_t e) {
+    while (b < e && (s[b] == ' ' || s[b] == '\t')) b++;
+    while (e > b && (s[e - 1] == ' ' || s[e - 1] == '\t')) e--;
+    std::string out = s.substr(b, e - b);
+    for (char& c : out) c = (char)std::tolower((unsigned char)c);
+    return out;
+}
+
+double ParseWeight(const std::string& text) {
+    if (text.empty()) return 0.0;
+    char* end = nullptr;
+    double q = std::strtod(text.c_str(), &end);
+    if (*end != '\0' || !(q >= 0.0)) return 0.0;   // also NaN
+    return q > 1.0 ? 1.0 : q;
+}
+
+} // namespace
+
+std::vector<AcceptEntry> AcceptList::Parse(const std::string& header) {
+    std::vector<AcceptEntry> entries;
+    size_t pos = 0;
+    while (pos < header.size()) {
+        size_t comma = header.find(',', pos);
+        if (comma == std::string::npos) comma = header.size();
+        size_t semi = header.find(';', pos);
+        if (semi == std::string::npos || semi > comma) semi = comma;
+
+        AcceptEntry entry;
+        entry.value = Trim(header, pos, semi);
+        while (semi < comma) {
+            size_t start = semi + 1;
+            semi = header.find(';', start);
+            if (semi == std::string::npos || semi > comma) semi = comma;
+            size_t eq = header.find('=', start);
+            if (eq == std::string::npos || eq >= semi) continue;
+            if (Trim(header, start, eq) == "q") entry.q = ParseWeight(Trim(header, eq + 1, semi));
+        }
+        pos = comma + 1;
+        if (!entry.value.empty()) entries.push_back(std::move(entry));
+    }
+    return entries;
+}
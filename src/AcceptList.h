@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// One entry of an Accept-style header, e.g. "application/cbor;q=0.5" or "gzip"
+struct AcceptEntry {
+    std::string value;   // trimmed, lowercased, parameters removed
+    double q = 1.0;      // from the "q" parameter; 0 when it is malformed
+};
+
+// Parser shared by the Accept and Accept-Encoding negotiation. Parameters
+// are split on ';' and only one named exactly "q" sets the weight, so
+// "application/cbor;seq=0" keeps q=1.
+class AcceptList {
+public:
+    static std::vector<AcceptEntry> Parse(const std::string& header);
+};
@@ -0,0 +1,228 @@
+#include "ApiServer.h"
+#include "httplib.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include "RateLimiter.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Set on the overflow thread: it answers priority routes only
+thread_local bool t_overflow = false;
+
+const char* RejectedName = "earthquake_api_rejected_total";
+const char* RejectedHelp = "Requests and connections turned away by admission control";
+
+void Reject(httplib::Response& res, int status, long long retryAfterSec, const char* message) {
+    res.status = status;
+    res.set_header("Retry-After", std::to_string(std::max(1LL, retryAfterSec)));
+    res.set_content(std::string("{\"error\": \"") + message + "\"}", "application/json");
+}
+
+}
+
+// httplib hands each accepted connection to the task queue as one job that
+// serves it until it closes. This queue runs them on a fixed pool; when
+// maxQueued jobs are already waiting, new connections go to the overflow
+// thread, which serves priority routes and answers everything else 503.
+class ApiServer::WorkerQueue : public httplib::TaskQueue {
+public:
+    static constexpr size_t OverflowBacklog = 256;   // beyond this, connections are just closed
+
+    explicit WorkerQueue(const ApiServerConfig& config)
+        : m_maxQueued(config.maxQueued),
+          m_rejected(Metrics::GetCounter(RejectedName, RejectedHelp, "reason=\"queue\"")) {
+        for (int i = 0; i < config.threads; i++) {
+            m_workers.emplace_back([this] {
+                Trace::SetThreadName("API worker");
+                run(m_jobs);
+            });
+        }
+        m_workers.emplace_back([this] {
+            Trace::SetThreadName("API overflow");
+            t_overflow = true;
+            run(m_overflow);
+        });
+    }
+
+    bool enqueue(std::function<void()> fn) override {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_shutdown) return false;
+            if (m_jobs.size() < m_maxQueued) {
+                m_jobs.push_back(std::move(fn));
+            } else if (m_overflow.size() < OverflowBacklog) {
+                m_overflow.push_back(std::move(fn));
+                m_rejected.Add();
+            } else {
+                return false;
+            }
+        }
+        m_cond.notify_all();
+        return true;
+    }
+
+    // Lets queued connections finish, then joins the pool
+    void shutdown() override {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_shutdown = true;
+        }
+        m_cond.notify_all();
+        for (auto& t : m_workers) t.join();
+    }
+
+private:
+    void run(std::deque<std::function<void()>>& jobs) {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock, [&] { return m_shutdown || !jobs.empty(); });
+                if (jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    const size_t m_maxQueued;
+    const Metrics::Counter m_rejected;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::function<void()>> m_jobs;
+    std::deque<std::function<void()>> m_overflow;
+    bool m_shutdown = false;
+    std::vector<std::thread> m_workers;
+};
+
+ApiServer::ApiServer(const ApiServerConfig& config) : m_config(config), m_server(std::make_unique<httplib::Server>()) {
+    if (m_config.threads < 1) m_config.threads = 1;
+    httplib::Server& svr = *m_server;
+    svr.new_task_queue = [this] { return new WorkerQueue(m_config); };
+    // Small JSON replies: don't let Nagle hold them back waiting for an ACK
+    svr.set_tcp_nodelay(true);
+    svr.set_keep_alive_timeout(m_config.keepAliveTimeoutSec);
+    svr.set_keep_alive_max_count((size_t)std::max(1, m_config.keepAliveMaxCount));
+    svr.set_read_timeout(m_config.readTimeoutSec, 0);
+    svr.set_write_timeout(m_config.writeTimeoutSec, 0);
+
+    if (m_config.adminPort > 0) {
+        m_admin = std::make_unique<httplib::Server>();
+        m_admin->new_task_queue = [] { return new httplib::ThreadPool(AdminThreads); };
+        m_admin->set_tcp_nodelay(true);
+        // One request per connection: an idle scraper never keeps an admin thread
+        m_admin->set_keep_alive_max_count(1);
+        m_admin->set_read_timeout(m_config.readTimeoutSec, 0);
+        m_admin->set_write_timeout(m_config.writeTimeoutSec, 0);
+    }
+
+    if (m_config.clientRate > 0) m_limiter = std::make_unique<ClientRateLimiter>(m_config.clientRate, m_config.clientBurst);
+
+    svr.set_pre_routing_handler([this](const httplib::Request& req, httplib::Response& res) {
+        if (!t_overflow) return httplib::Server::HandlerResponse::Unhandled;
+        if (isPriority(req.path)) {
+            res.set_header("Connection", "close");   // one answer per connection frees the lane
+            return httplib::Server::HandlerResponse::Unhandled;
+        }
+        Reject(res, 503, 1, "server busy");
+        return httplib::Server::HandlerResponse::Handled;
+    });
+}
+
+bool ApiServer::isPriority(const std::string& path) const {
+    return std::find(m_config.priorityRoutes.begin(), m_config.priorityRoutes.end(), path) != m_config.priorityRoutes.end();
+}
+
+void ApiServer::Get(const std::string& pattern, Handler handler) {
+    std::string route = "route=\"" + pattern + "\"";
+    auto latency = Metrics::GetHistogram("earthquake_api_request_seconds",
+                                         "Time to produce an API response (large bodies are streamed afterwards)", route);
+    Metrics::Counter byClass[4];   // 2xx .. 5xx
+    for (int c = 0; c < 4; c++) {
+        byClass[c] = Metrics::GetCounter("earthquake_api_responses_total", "API responses by status class",
+                                         route + ",code=\"" + std::to_string(c + 2) + "xx\"");
+    }
+    auto throttled = Metrics::GetCounter(RejectedName, RejectedHelp, "reason=\"rate\"");
+    auto saturated = Metrics::GetCounter(RejectedName, RejectedHelp, "reason=\"in_flight\"");
+    bool priority = isPriority(pattern);
+
+    auto serve = [this, handler = std::move(handler), latency, byClass, throttled, saturated, priority](
+                     const httplib::Request& req, httplib::Response& res) {
+        auto start = Metrics::Clock::now();
+        int64_t waitMs = 0;
+        if (priority) {
+            handler(req, res);
+        } else if (m_limiter && (waitMs = m_limiter->Acquire(req.remote_addr)) > 0) {
+            throttled.Add();
+            Reject(res, 429, (waitMs + 999) / 1000, "rate limit exceeded");
+        } else if (m_config.maxInFlight > 0 && m_inFlight.fetch_add(1, std::memory_order_acquire) >= m_config.maxInFlight) {
+            m_inFlight.fetch_sub(1, std::memory_order_release);
+            saturated.Add();
+            Reject(res, 503, 1, "server busy");
+        } else {
+            handler(req, res);
+            if (m_config.maxInFlight > 0) m_inFlight.fetch_sub(1, std::memory_order_release);
+        }
+        latency.ObserveSince(start);
+        int status = res.status < 0 ? 200 : res.status;   // httplib fills in 200 afterwards
+        if (status >= 200 && status < 600) byClass[status / 100 - 2].Add();
+    };
+    if (priority && m_admin) m_admin->Get(pattern, serve);
+    m_server->Get(pattern, std::move(serve));
+}
+
+ApiServer::~ApiServer() {
+    stop();
+}
+
+bool ApiServer::start(int port) {
+    if (m_thread.joinable()) return true;
+    // Bind here so a failure is reported to the caller's log right away and
+    // stop() always has a live socket to shut down
+    std::cout << "Starting API Server on port " << port << " (" << m_config.threads << " workers)..." << std::endl;
+    if (!m_server->bind_to_port("0.0.0.0", port)) {
+        std::cerr << "API Server failed to bind port " << port << std::endl;
+        return false;
+    }
+    if (m_admin && !m_admin->bind_to_port("0.0.0.0", m_config.adminPort)) {
+        std::cerr << "API Server failed to bind admin port " << m_config.adminPort << std::endl;
+        m_admin.reset();
+    } else if (m_admin) {
+        std::cout << "Priority routes also on admin port " << m_config.adminPort << std::endl;
+    }
+    m_thread = std::thread([this] {
+        Trace::SetThreadName("API server");
+        m_server->listen_after_bind();
+    });
+    if (m_admin) {
+        m_adminThread = std::thread([this] {
+            Trace::SetThreadName("API admin");
+            m_admin->listen_after_bind();
+        });
+    }
+    // httplib only marks the server running inside listen_after_bind(); a
+    // stop() before that would be a no-op and leave join() waiting forever
+    m_server->wait_until_ready();
+    if (m_admin) m_admin->wait_until_ready();
+    return true;
+}
+
+void ApiServer::stop() {
+    if (!m_thread.joinable()) return;
+    // Closes the listener; listen_after_bind() then shuts the worker queue
+    // down, which waits for in-flight connections, before returning
+    m_server->stop();
+    if (m_admin) m_admin->stop();
+    m_thread.join();
+    if (m_adminThread.joinable()) m_adminThread.join();
+}
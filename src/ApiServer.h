@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace httplib { class Server; struct Request; struct Response; }
+
+struct ApiServerConfig {
+    int threads = 16;               // worker pool; each keep-alive connection holds one worker
+    size_t maxQueued = 64;          // accepted connections waiting for a worker before 503s
+    int keepAliveTimeoutSec = 2;    // idle time before a kept-alive connection frees its worker
+    int keepAliveMaxCount = 1000;   // requests per connection
+    int readTimeoutSec = 5;
+    int writeTimeoutSec = 5;
+
+    double clientRate = 50;         // sustained requests/s per remote address, 0 = unlimited
+    double clientBurst = 100;
+    int maxInFlight = 12;           // other routes handled at once before 503s, 0 = unlimited
+    std::vector<std::string> priorityRoutes{"/status", "/metrics"};   // exempt from all limits
+    int adminPort = 0;              // also serve priority routes here, on AdminThreads of their own; 0 = off
+
+    bool debugTrace = false;        // serve GET /debug/trace (the whole trace dump) to loopback clients
+};
+
+// The HTTP server behind startAPIServer(): httplib::Server on a bounded
+// worker pool. Connections beyond the pool wait in a queue of maxQueued;
+// past that they go to a separate overflow thread, so a spike is refused
+// quickly instead of piling up threads or being reset. stop() closes the
+// listeners and joins every thread.
+//
+// Admission per request: a client (remote address) over its token bucket
+// gets 429, and a request beyond maxInFlight concurrent handlers gets 503,
+// both with Retry-After. Priority routes skip both checks and are still
+// answered by the overflow thread, but that thread and the pool serve
+// connections in arrival order, so idle clients can delay them for seconds.
+// With adminPort set they are also served by a listener and pool of their
+// own, which health checks and scrapes should use.
+class ApiServer {
+public:
+    static constexpr int AdminThreads = 2;
+
+    explicit ApiServer(const ApiServerConfig& config = ApiServerConfig());
+    ~ApiServer();
+
+    using Handler = std::function<void(const httplib::Request&, httplib::Response&)>;
+
+    // Registers a GET route (before start()). Handler time and status class
+    // are recorded in /metrics under route="<pattern>".
+    void Get(const std::string& pattern, Handler handler);
+
+    httplib::Server& server() { return *m_server; }
+
+    // Binds synchronously (false if the port is taken), then serves on a
+    // thread of its own. If adminPort cannot be bound, priority routes are
+    // served on `port` only.
+    bool start(int port);
+    void stop();
+
+private:
+    class WorkerQueue;
+
+    bool isPriority(const std::string& path) const;
+
+    ApiServerConfig m_config;
+    std::unique_ptr<class ClientRateLimiter> m_limiter;
+    std::atomic<int> m_inFlight{0};
+    std::unique_ptr<httplib::Server> m_server;
+    std::unique_ptr<httplib::Server> m_admin;        // priority routes only, when adminPort is set
+    std::thread m_thread;
+    std::thread m_adminThread;
+};
@@ -0,0 +1,152 @@
+#include "AssetLoader.h"
+#include "httplib.h"
+#include "Trace.h"
+
+// --- IMAGE LOADING LIBRARY ---
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <iostream>
+
+AssetLoader::AssetLoader(int workerCount, std::string cacheDir) : m_cacheDir(std::move(cacheDir)) {
+    for (int i = 0; i < workerCount; i++) {
+        m_workers.emplace_back(&AssetLoader::workerLoop, this);
+    }
+}
+
+AssetLoader::~AssetLoader() {
+    m_running = false;
+    m_cv.notify_all();
+    for (auto& t : m_workers) {
+        if (t.joinable()) t.join();
+    }
+}
+
+void AssetLoader::request(const std::string& key, const std::string& host, const std::string& path, const std::string& cacheFile) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_states.count(key)) return;
+        m_states[key] = State::Pending;
+        m_jobs.push_back({key, host, path, cacheFile});
+    }
+    m_cv.notify_one();
+}
+
+void AssetLoader::pollCompleted(const std::function<void(DecodedImage&)>& upload) {
+    std::vector<DecodedImage> done;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_completed.empty()) return;
+        done.swap(m_completed);
+    }
+    for (auto& img : done) upload(img);
+}
+
+void AssetLoader::setOnComplete(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_onComplete = std::move(callback);
+}
+
+bool AssetLoader::isPending(const std::string& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_states.find(key);
+    return it != m_states.end() && it->second == State::Pending;
+}
+
+bool AssetLoader::hasFailed(const std::string& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_states.find(key);
+    return it != m_states.end() && it->second == State::Failed;
+}
+
+void AssetLoader::clearFailed(const std::string& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_states.find(key);
+    if (it != m_states.end() && it->second == State::Failed) m_states.erase(it);
+}
+
+bool AssetLoader::fetchBytes(const Job& job, std::string& bytes) {
+    namespace fs = std::filesystem;
+    fs::path file = fs::path(m_cacheDir) / job.cacheFile;
+
+    // 1. Disk cache
+    std::error_code ec;
+    if (fs::exists(file, ec)) {
+        std::ifstream in(file, std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        bytes = ss.str();
+        if (!bytes.empty()) return true;
+    }
+
+    // 2. Network, then persist for the next launch
+    httplib::Client cli(job.host);
+    cli.set_follow_location(true);
+    cli.set_connection_timeout(5);
+    cli.set_read_timeout(15);
+    auto res = cli.Get(job.path.c_str());
+    if (!res || res->status != 200) return false;
+    bytes = std::move(res->body);
+
+    fs::create_directories(file.parent_path(), ec);
+    fs::path tmp = file;
+    tmp += ".part";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        out.write(bytes.data(), (std::streamsize)bytes.size());
+    }
+    fs::rename(tmp, file, ec);
+    return true;
+}
+
+void AssetLoader::workerLoop() {
+    Trace::SetThreadName("AssetLoader worker");
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return !m_running || !m_jobs.empty(); });
+            if (!m_running) return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        DecodedImage img;
+        img.key = job.key;
+        std::string bytes;
+        bool ok;
+        {
+            TRACE_SCOPE("AssetLoader::fetchBytes");
+            ok = fetchBytes(job, bytes);
+        }
+        if (ok) {
+            TRACE_SCOPE("AssetLoader::decode");
+            int channels = 0;
+            unsigned char* data = stbi_load_from_memory((const unsigned char*)bytes.data(), (int)bytes.size(), &img.width, &img.height, &channels, 4);
+            ok = data != nullptr;
+            if (ok) {
+                img.pixels.assign(data, data + (size_t)img.width * img.height * 4);
+                stbi_image_free(data);
+            }
+        }
+        if (!ok) {
+            // Drop a corrupt cache entry so the next launch downloads it again
+            std::error_code ec;
+            std::filesystem::remove(std::filesystem::path(m_cacheDir) / job.cacheFile, ec);
+            std::cerr << "Asset failed: " << job.key << std::endl;
+        }
+
+        std::function<void()> notify;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // Failures stay cached so the UI never retries them every frame
+            m_states[job.key] = ok ? State::Done : State::Failed;
+            if (ok) m_completed.push_back(std::move(img));
+            notify = m_onComplete;
+        }
+        if (notify) notify();
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+// Decoded RGBA8 image handed back to the render thread for upload.
+struct DecodedImage {
+    std::string key;
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// Background image loader: disk cache -> HTTP -> stb decode on worker
+// threads. Only the GL upload is left to the caller on the render thread.
+class AssetLoader {
+public:
+    explicit AssetLoader(int workerCount = 2, std::string cacheDir = "cache");
+    ~AssetLoader();
+
+    // Queue an image. cacheFile is relative to the cache directory.
+    // Keys that are already pending, loaded or failed are ignored.
+    void request(const std::string& key, const std::string& host, const std::string& path, const std::string& cacheFile);
+
+    // Render thread: pass every finished image to `upload`.
+    void pollCompleted(const std::function<void(DecodedImage&)>& upload);
+
+    bool isPending(const std::string& key);
+    bool hasFailed(const std::string& key);
+
+    // Forget a failed key so the next request() queues it again.
+    void clearFailed(const std::string& key);
+
+    // Called from a worker thread when an image is ready for upload or has failed.
+    void setOnComplete(std::function<void()> callback);
+
+private:
+    enum class State { Pending, Done, Failed };
+
+    struct Job {
+        std::string key;
+        std::string host;
+        std::string path;
+        std::string cacheFile;
+    };
+
+    void workerLoop();
+    bool fetchBytes(const Job& job, std::string& bytes);
+
+    std::string m_cacheDir;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Job> m_jobs;
+    std::vector<DecodedImage> m_completed;
+    std::unordered_map<std::string, State> m_states;
+
+    std::function<void()> m_onComplete;
+    std::atomic<bool> m_running{true};
+    std::vector<std::thread> m_workers;
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include "imgui.h"
+#include "GLHeaders.h"
+#include "AssetLoader.h"
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// A mipmapped piece of the world map; min/max are normalized [0,1]
+// coordinates of the tile inside the full equirectangular image.
+struct MapTile {
+    ImTextureID texture = 0;
+    ImVec2 min, max;
+};
+
+// Base map that arrives asynchronously: the decoded image is split into
+// tiles that are uploaded a few per frame, so neither the download, the
+// decode nor one big texture upload ever stalls a frame.
+class BaseMap {
+public:
+    static constexpr const char* AssetKey = "basemap";
+    static constexpr int TileSize = 512;
+    static constexpr int RetrySeconds = 30;
+
+    void Request(AssetLoader& loader) {
+        loader.request(AssetKey, "upload.wikimedia.org", "/wikipedia/commons/8/83/Equirectangular_projection_SW.jpg", "basemap.jpg");
+    }
+
+    // Once per frame: a failed download or decode is requested again
+    // RetrySeconds later instead of leaving the placeholder up for good.
+    void Update(AssetLoader& loader) {
+        if (m_cols > 0) return;
+        auto now = std::chrono::steady_clock::now();
+        if (!m_failed) {
+            if (!loader.hasFailed(AssetKey)) return;
+            m_failed = true;
+            m_retryAt = now + std::chrono::seconds(RetrySeconds);
+        } else if (now >= m_retryAt) {
+            m_failed = false;
+            loader.clearFailed(AssetKey);
+            Request(loader);
+        }
+    }
+
+    // Take ownership of the decoded image (render thread).
+    void SetImage(DecodedImage&& img) {
+        m_image = std::move(img);
+        m_cols = (m_image.width + TileSize - 1) / TileSize;
+        m_rows = (m_image.height + TileSize - 1) / TileSize;
+        m_nextTile = 0;
+    }
+
+    // Upload up to maxTiles pending tiles; call once per frame.
+    void UploadPending(int maxTiles = 2) {
+        int total = m_cols * m_rows;
+        for (int n = 0; n < maxTiles && m_nextTile < total; n++, m_nextTile++) {
+            int tx = m_nextTile % m_cols, ty = m_nextTile / m_cols;
+            int x0 = tx * TileSize, y0 = ty * TileSize;
+            int w = std::min(TileSize, m_image.width - x0);
+            int h = std::min(TileSize, m_image.height - y0);
+
+            m_scratch.resize((size_t)w * h * 4);
+            for (int y = 0; y < h; y++) {
+                std::memcpy(m_scratch.data() + (size_t)y * w * 4,
+                            m_image.pixels.data() + ((size_t)(y0 + y) * m_image.width + x0) * 4, (size_t)w * 4);
+            }
+
+            GLuint tex;
+            glGenTextures(1, &tex);
+            glBindTexture(GL_TEXTURE_2D, tex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_scratch.data());
+            glGenerateMipmap(GL_TEXTURE_2D);
+
+            MapTile t;
+            t.texture = (ImTextureID)(intptr_t)tex;
+            t.min = ImVec2(x0 / (float)m_image.width, y0 / (float)m_image.height);
+            t.max = ImVec2((x0 + w) / (float)m_image.width, (y0 + h) / (float)m_image.height);
+            m_tiles.push_back(t);
+        }
+        if (total > 0 && m_nextTile == total && !m_image.pixels.empty()) {
+            // Everything is on the GPU; drop the CPU copy
+            m_image.pixels.clear();
+            m_image.pixels.shrink_to_fit();
+            m_scratch.clear();
+            m_scratch.shrink_to_fit();
+        }
+    }
+
+    // Tiles are only shown once the whole map is resident, so the
+    // placeholder never mixes with a half-uploaded map.
+    bool IsReady() const { return m_cols > 0 && (int)m_tiles.size() == m_cols * m_rows; }
+    bool HasPendingUploads() const { return m_nextTile < m_cols * m_rows; }
+    bool HasFailed() const { return m_failed; }
+    int RetryInSeconds() const {
+        auto left = std::chrono::duration_cast<std::chrono::seconds>(m_retryAt - std::chrono::steady_clock::now()).count();
+        return (int)std::max<long long>(left, 0);
+    }
+    const std::vector<MapTile>& Tiles() const { return m_tiles; }
+
+private:
+    DecodedImage m_image;
+    std::vector<unsigned char> m_scratch;
+    std::vector<MapTile> m_tiles;
+    int m_cols = 0, m_rows = 0, m_nextTile = 0;
+    bool m_failed = false;
+    std::chrono::steady_clock::time_point m_retryAt;
+};
@@ -0,0 +1,159 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+
+// Hierarchical lat/lon grid of event aggregates used for map clustering.
+// Level 0 is BaseCols x BaseRows cells; every level doubles both axes.
+// Inserts and removals touch one cell per level, so the pyramid follows
+// feed change sets without a rebuild.
+class ClusterPyramid {
+public:
+    static constexpr int Levels = 10;
+    static constexpr int BaseCols = 4;
+    static constexpr int BaseRows = 2;
+
+    struct Cell {
+        int count = 0;
+        double sumLon = 0.0;
+        double sumLat = 0.0;
+        double maxMag = 0.0;
+
+        double lon() const { return sumLon / count; }
+        double lat() const { return sumLat / count; }
+    };
+
+    static int Cols(int level) { return BaseCols << level; }
+    static int Rows(int level) { return BaseRows << level; }
+
+    static int CellX(int level, double lon) { return std::clamp((int)((lon + 180.0) / 360.0 * Cols(level)), 0, Cols(level) - 1); }
+    static int CellY(int level, double lat) { return std::clamp((int)((90.0 - lat) / 180.0 * Rows(level)), 0, Rows(level) - 1); }
+
+    void Clear() {
+        for (auto& l : m_levels) l.clear();
+        m_leafMembers.clear();
+        m_entries.clear();
+        m_revision++;
+    }
+
+    // Insert or replace the event with this id.
+    void Insert(const std::string& id, double lon, double lat, double mag) {
+        if (m_entries.count(id)) Remove(id);
+        m_entries[id] = {lon, lat, mag};
+
+        for (int l = 0; l < Levels; l++) {
+            Cell& c = m_levels[l][Key(l, CellX(l, lon), CellY(l, lat))];
+            if (c.count == 0 || mag > c.maxMag) c.maxMag = mag;
+            c.count++;
+            c.sumLon += lon;
+            c.sumLat += lat;
+        }
+        m_leafMembers[Key(Levels - 1, CellX(Levels - 1, lon), CellY(Levels - 1, lat))].push_back({id, mag});
+        m_revision++;
+    }
+
+    void Remove(const std::string& id) {
+        auto it = m_entries.find(id);
+        if (it == m_entries.end()) return;
+        Entry e = it->second;
+        m_entries.erase(it);
+
+        // Leaf first, so coarser levels can recompute their max from children
+        uint64_t leafKey = Key(Levels - 1, CellX(Levels - 1, e.lon), CellY(Levels - 1, e.lat));
+        auto& members = m_leafMembers[leafKey];
+        for (size_t i = 0; i < members.size(); i++) {
+            if (members[i].id == id) { members[i] = std::move(members.back()); members.pop_back(); break; }
+        }
+        if (members.empty()) m_leafMembers.erase(leafKey);
+
+        for (int l = Levels - 1; l >= 0; l--) {
+            int cx = CellX(l, e.lon), cy = CellY(l, e.lat);
+            auto cit = m_levels[l].find(Key(l, cx, cy));
+            if (cit == m_levels[l].end()) continue;
+            Cell& c = cit->second;
+            if (--c.count == 0) { m_levels[l].erase(cit); continue; }
+            c.sumLon -= e.lon;
+            c.sumLat -= e.lat;
+            if (e.mag >= c.maxMag) c.maxMag = RecomputeMax(l, cx, cy);
+        }
+        m_revision++;
+    }
+
+    size_t Size() const { return m_entries.size(); }
+    uint64_t Revision() const { return m_revision; }
+
+    const Cell* Find(int level, int cx, int cy) const {
+        auto it = m_levels[level].find(Key(level, cx, cy));
+        return it == m_levels[level].end() ? nullptr : &it->second;
+    }
+
+    // Visit the non-empty cells of `level` inside [x0,x1] x [y0,y1].
+    // Cost is bounded by the smaller of the range area and the populated cells.
+    template <typename F>
+    void ForEachCell(int level, int x0, int y0, int x1, int y1, F&& visit) const {
+        x0 = std::max(x0, 0); y0 = std::max(y0, 0);
+        x1 = std::min(x1, Cols(level) - 1); y1 = std::min(y1, Rows(level) - 1);
+        if (x0 > x1 || y0 > y1) return;
+
+        const auto& cells = m_levels[level];
+        if ((size_t)(x1 - x0 + 1) * (size_t)(y1 - y0 + 1) <= cells.size()) {
+            for (int y = y0; y <= y1; y++)
+                for (int x = x0; x <= x1; x++)
+                    if (const Cell* c = Find(level, x, y)) visit(x, y, *c);
+        } else {
+            for (const auto& [key, c] : cells) {
+                int x = (int)(key % (uint64_t)Cols(level)), y = (int)(key / (uint64_t)Cols(level));
+                if (x >= x0 && x <= x1 && y >= y0 && y <= y1) visit(x, y, c);
+            }
+        }
+    }
+
+    // Id of the single event in a cell with count == 1.
+    std::string SingleMember(int level, int cx, int cy) const {
+        for (int l = level; l < Levels - 1; l++) {
+            bool found = false;
+            for (int dy = 0; dy < 2 && !found; dy++) {
+                for (int dx = 0; dx < 2 && !found; dx++) {
+                    if (Find(l + 1, cx * 2 + dx, cy * 2 + dy)) { cx = cx * 2 + dx; cy = cy * 2 + dy; found = true; }
+                }
+            }
+            if (!found) return "";
+        }
+        auto it = m_leafMembers.find(Key(Levels - 1, cx, cy));
+        return (it == m_leafMembers.end() || it->second.empty()) ? "" : it->second.front().id;
+    }
+
+private:
+    struct Entry { double lon, lat, mag; };
+    struct Member { std::string id; double mag; };
+
+    static uint64_t Key(int level, int cx, int cy) { return (uint64_t)cy * (uint64_t)Cols(level) + (uint64_t)cx; }
+
+    double RecomputeMax(int level, int cx, int cy) const {
+        double best = 0.0;
+        bool any = false;
+        if (level == Levels - 1) {
+            auto it = m_leafMembers.find(Key(level, cx, cy));
+            if (it != m_leafMembers.end()) {
+                for (const auto& m : it->second) { if (!any || m.mag > best) best = m.mag; any = true; }
+            }
+            return best;
+        }
+        for (int dy = 0; dy < 2; dy++) {
+            for (int dx = 0; dx < 2; dx++) {
+                if (const Cell* c = Find(level + 1, cx * 2 + dx, cy * 2 + dy)) {
+                    if (!any || c->maxMag > best) best = c->maxMag;
+                    any = true;
+                }
+            }
+        }
+        return best;
+    }
+
+    std::unordered_map<uint64_t, Cell> m_levels[Levels];
+    std::unordered_map<uint64_t, std::vector<Member>> m_leafMembers;
+    std::unordered_map<std::string, Entry> m_entries;
+    uint64_t m_revision = 0;
+};
@@ -0,0 +1,78 @@
+#include "EarthquakeService.h"
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <chrono>
+#include <thread>
+
+// Headless node: runs the fetch loop and the API server without GLFW,
+// OpenGL or ImGui. Stops cleanly on SIGINT / SIGTERM.
+
+namespace {
+volatile std::sig_atomic_t g_stopRequested = 0;
+
+void OnSignal(int) { g_stopRequested = 1; }
+
+void PrintUsage(const char* argv0) {
+    std::cout << "Usage: " << argv0 << " [--port N] [--sse-port N] [--admin-port N (0 = off)] [--interval SECONDS] [--min-mag M]"
+              << " [--threads N] [--max-queued N] [--keep-alive SECONDS]"
+              << " [--client-rate R] [--client-burst N] [--max-in-flight N] [--debug-trace]" << std::endl;
+}
+}
+
+int main(int argc, char** argv) {
+    int port = 8080;
+    int ssePort = 8081;
+    int interval = 15;
+    float minMag = 0.0f;
+    int maxQueued = (int)ApiServerConfig().maxQueued;
+    ApiServerConfig api;
+    api.adminPort = 8082;   // /status and /metrics, isolated from the main port's pool
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--port") && hasValue) port = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--sse-port") && hasValue) ssePort = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--admin-port") && hasValue) api.adminPort = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--interval") && hasValue) interval = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--min-mag") && hasValue) minMag = (float)std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--threads") && hasValue) api.threads = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--max-queued") && hasValue) maxQueued = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--keep-alive") && hasValue) api.keepAliveTimeoutSec = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--client-rate") && hasValue) api.clientRate = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--client-burst") && hasValue) api.clientBurst = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--max-in-flight") && hasValue) api.maxInFlight = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--debug-trace")) api.debugTrace = true;
+        else { PrintUsage(argv[0]); return std::strcmp(argv[i], "--help") ? 1 : 0; }
+    }
+    if (port <= 0 || ssePort <= 0 || api.adminPort < 0 || interval <= 0 || api.threads <= 0 || maxQueued < 1 || api.keepAliveTimeoutSec < 0
+        || api.clientRate < 0 || api.clientBurst < 1 || api.maxInFlight < 0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    api.maxQueued = (size_t)maxQueued;
+
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+
+    EarthquakeService service;
+    service.setMinMagnitude(minMag);
+    service.startEventStream(ssePort);
+    service.startBackgroundService(interval);
+    service.startAPIServer(port, api);
+
+    std::string lastStatus;
+    while (!g_stopRequested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        std::string status = service.getStatus();
+        if (status != lastStatus) {
+            std::cout << status << std::endl;
+            lastStatus = status;
+        }
+    }
+
+    std::cout << "Shutting down..." << std::endl;
+    service.stopService();
+    return 0;
+}
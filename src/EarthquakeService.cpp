@@ -1,9 +1,241 @@
 #include "EarthquakeService.h"
 #include "httplib.h" 
+#include "Trace.h"
+#include "Metrics.h"
+#include "QuakeJson.h"
+#include "QuakeBinary.h"
+#include "Gzip.h"
+#include "QuakeIndex.h"
+#include "QuakeAggregates.h"
+#include "ResponseCache.h"
+#include "EventStream.h"
 #include <iostream>
 #include <chrono>
+#include <unordered_map>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <cmath>
 
-EarthquakeService::EarthquakeService() {}
+namespace {
+
+// Send a cached body straight from the shared buffer instead of copying it
+void SendCached(httplib::Response& res, std::shared_ptr<const CachedResponse> cached) {
+    size_t size = cached->body.size();
+    std::string type = cached->contentType;
+    if (!cached->contentEncoding.empty()) res.set_header("Content-Encoding", cached->contentEncoding);
+    res.set_content_provider(size, type, [cached](size_t offset, size_t length, httplib::DataSink& sink) {
+        return sink.write(cached->body.data() + offset, length);
+    });
+}
+
+// Ingestion series in /metrics
+struct ServiceMetrics {
+    Metrics::Histogram download, parse, publish;
+    Metrics::Counter bytes, features, failures, inserted, updated, removed;
+    Metrics::Gauge version, quakes;
+};
+
+const ServiceMetrics& Ingest() {
+    static const ServiceMetrics m = [] {
+        const char* phase = "earthquake_fetch_phase_seconds";
+        const char* phaseHelp = "Duration of each step of a feed fetch";
+        const char* changes = "earthquake_snapshot_changes_total";
+        const char* changesHelp = "Events changed by published snapshots";
+        ServiceMetrics r;
+        r.download = Metrics::GetHistogram(phase, phaseHelp, "phase=\"download\"");
+        r.parse = Metrics::GetHistogram(phase, phaseHelp, "phase=\"parse\"");
+        r.publish = Metrics::GetHistogram(phase, phaseHelp, "phase=\"publish\"");
+        r.bytes = Metrics::GetCounter("earthquake_fetch_bytes_total", "Feed bytes downloaded");
+        r.features = Metrics::GetCounter("earthquake_features_parsed_total", "GeoJSON features parsed");
+        r.failures = Metrics::GetCounter("earthquake_fetch_failures_total", "Fetches that got no usable response");
+        r.inserted = Metrics::GetCounter(changes, changesHelp, "kind=\"inserted\"");
+        r.updated = Metrics::GetCounter(changes, changesHelp, "kind=\"updated\"");
+        r.removed = Metrics::GetCounter(changes, changesHelp, "kind=\"removed\"");
+        r.version = Metrics::GetGauge("earthquake_snapshot_version", "Version of the published snapshot");
+        r.quakes = Metrics::GetGauge("earthquake_snapshot_quakes", "Events in the published snapshot");
+        return r;
+    }();
+    return m;
+}
+
+// {"error": message} with 400 Bad Request
+void SendBadRequest(httplib::Response& res, const std::string& message) {
+    std::string body = "{\"error\": ";
+    QuakeJson::AppendString(body, message);
+    body += "}";
+    res.status = 400;
+    res.set_content(body, "application/json");
+}
+
+// Large /quakes pages as a chunked JSON stream, serialized StreamBatch
+// quakes at a time straight from the snapshot (and gzipped per batch), so
+// a request holds one batch in memory instead of the whole body
+void StreamQueryResult(httplib::Response& res, std::shared_ptr<const QuakeSnapshot> snapshot,
+                       QuakeQueryResult result, const QuakeQuery& query, bool gzip) {
+    struct State {
+        std::shared_ptr<const QuakeSnapshot> snapshot;
+        QuakeQueryResult result;
+        QuakeQuery query;
+        size_t next = 0;
+        std::unique_ptr<GzipStream> gzip;
+        std::string batch, packed;
+    };
+    auto state = std::make_shared<State>();
+    state->snapshot = std::move(snapshot);
+    state->result = std::move(result);
+    state->query = query;
+    if (gzip) {
+        state->gzip = std::make_unique<GzipStream>();
+        res.set_header("Content-Encoding", "gzip");
+    }
+
+    res.set_chunked_content_provider("application/json", [state](size_t, httplib::DataSink& sink) {
+        TRACE_SCOPE("stream /quakes batch");
+        State& s = *state;
+        const auto& items = s.result.items;
+        s.batch.clear();
+        if (s.next == 0) QuakeJson::AppendQueryHead(s.batch, *s.snapshot, s.result, s.query);
+        size_t end = std::min(s.next + EarthquakeService::StreamBatch, items.size());
+        for (size_t i = s.next; i < end; i++) {
+            if (i) s.batch += ',';
+            QuakeJson::AppendQuake(s.batch, s.snapshot->quakes[items[i]]);
+        }
+        s.next = end;
+        bool last = end == items.size();
+        if (last) s.batch += "]}";
+
+        const std::string* out = &s.batch;
+        if (s.gzip) {
+            if (!s.gzip->Write(s.batch, last, s.packed)) return false;
+            out = &s.packed;
+        }
+        if (!out->empty() && !sink.write(out->data(), out->size())) return false;
+        if (last) sink.done();
+        return true;
+    });
+}
+
+// Body in the negotiated format: `json` writes the JSON text, `doc` builds
+// the document for the binary encodings
+template <typename Json, typename Doc>
+CachedResponse Encoded(QuakeBinary::Format format, Json&& json, Doc&& doc) {
+    if (format == QuakeBinary::Format::Json) return CachedResponse{"application/json", json()};
+    return CachedResponse{QuakeBinary::ContentType(format), QuakeBinary::Encode(doc(), format)};
+}
+
+const char* GzipSuffix = "#gzip";
+const char* StatusKey = "/status";
+const char* ChangesFullKey = "/quakes/changes?full";
+
+std::string QuakesKey(const QuakeQuery& query) { return "/quakes?" + query.Key(); }
+
+// Whole-string decimal; rejects empty, signed and trailing junk
+bool ParseUnsigned(const std::string& text, unsigned long long& out) {
+    if (text.empty() || text[0] < '0' || text[0] > '9') return false;
+    char* end = nullptr;
+    errno = 0;
+    out = std::strtoull(text.c_str(), &end, 10);
+    return errno == 0 && *end == '\0';
+}
+
+// Versions restart at 1 with every process, so tags carry the start time too
+const unsigned long long ProcessEpoch = (unsigned long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+
+// Strong validator for one response key of one snapshot version. Computed
+// from the key alone, so a revalidation never touches the body.
+std::string MakeETag(uint64_t version, const std::string& key) {
+    uint64_t h = 1469598103934665603ULL;   // FNV-1a
+    for (unsigned char c : key) { h ^= c; h *= 1099511628211ULL; }
+    char buf[80];
+    std::snprintf(buf, sizeof(buf), "\"%llx-%llu-%016llx\"", ProcessEpoch, (unsigned long long)version, (unsigned long long)h);
+    return buf;
+}
+
+// If-None-Match: "*" or a list of tags; weak comparison (W/ ignored)
+bool MatchesETag(const httplib::Request& req, const std::string& etag) {
+    if (!req.has_header("If-None-Match")) return false;
+    std::string header = req.get_header_value("If-None-Match");
+    size_t pos = 0;
+    while (pos <= header.size()) {
+        size_t comma = header.find(',', pos);
+        if (comma == std::string::npos) comma = header.size();
+        size_t b = header.find_first_not_of(" \t", pos);
+        size_t e = header.find_last_not_of(" \t", comma - 1);
+        if (b != std::string::npos && b < comma && e != std::string::npos && e >= b) {
+            std::string tag = header.substr(b, e - b + 1);
+            if (tag.compare(0, 2, "W/") == 0) tag.erase(0, 2);
+            if (tag == "*" || tag == etag) return true;
+        }
+        pos = comma + 1;
+    }
+    return false;
+}
+
+// gzip representation of `plain`; a body too small to gain is kept as-is
+CachedResponse Compressed(const CachedResponse& plain) {
+    if (plain.body.size() < Gzip::MinSize) return plain;
+    TRACE_SCOPE("gzip response");
+    std::string packed = Gzip::Compress(plain.body);
+    if (packed.empty()) return plain;
+    return CachedResponse{plain.contentType, std::move(packed), "gzip"};
+}
+
+// Cached body for `key`, gzipped when `gzip` is set and the body is big
+// enough to gain from it. The compressed copy is its own cache entry, so
+// each snapshot compresses a response at most once; a small body is
+// stored under the gzip key as-is, so repeat requests are a single lookup.
+template <typename Build>
+std::shared_ptr<const CachedResponse> GetOrBuildEncoded(ResponseCache& cache, const std::string& key, bool gzip, Build&& build) {
+    if (!gzip) return cache.GetOrBuild(key, std::forward<Build>(build));
+    return cache.GetOrBuild(key + GzipSuffix, [&] { return Compressed(*cache.GetOrBuild(key, std::forward<Build>(build))); });
+}
+
+// The same representation built for this request only, for bodies too big to cache
+template <typename Build>
+std::shared_ptr<const CachedResponse> BuildEncoded(bool gzip, Build&& build) {
+    CachedResponse plain = build();
+    return std::make_shared<const CachedResponse>(gzip ? Compressed(plain) : std::move(plain));
+}
+
+// Validator headers for `key`; answers 304 and returns true when the
+// client's tag is current. `gzip` reports whether the client takes gzip,
+// which selects a separately tagged representation. `vary` names the
+// request headers besides Accept-Encoding that pick the body.
+bool Revalidate(const httplib::Request& req, httplib::Response& res, const QuakeSnapshot& snapshot,
+                const std::string& key, const char* vary, bool& gzip) {
+    gzip = Gzip::Accepted(req.get_header_value("Accept-Encoding"));
+    std::string etag = MakeETag(snapshot.version, gzip ? key + GzipSuffix : key);
+    res.set_header("ETag", etag);
+    res.set_header("Cache-Control", "no-cache");
+    res.set_header("Vary", vary ? std::string(vary) + ", Accept-Encoding" : std::string("Accept-Encoding"));
+    if (!MatchesETag(req, etag)) return false;
+    res.status = 304;
+    return true;
+}
+
+// Answer from the snapshot's cache: 304 when the client's tag is current,
+// otherwise the cached body (serialized by `build` on the first request).
+template <typename Build>
+void ServeCached(const httplib::Request& req, httplib::Response& res, const QuakeSnapshot& snapshot,
+                 const std::string& key, Build&& build, const char* vary = nullptr) {
+    bool gzip = false;
+    if (Revalidate(req, res, snapshot, key, vary, gzip)) return;
+    SendCached(res, GetOrBuildEncoded(*snapshot.responses, key, gzip, std::forward<Build>(build)));
+}
+
+}
+
+EarthquakeService::EarthquakeService() : m_aggregator(std::make_unique<QuakeAggregator>()) {
+    auto empty = std::make_shared<QuakeSnapshot>();
+    empty->index = std::make_shared<QuakeIndex>(empty->quakes);
+    empty->aggregates = m_aggregator->Publish();
+    empty->responses = std::make_shared<ResponseCache>();
+    m_snapshot = std::move(empty);
+}
 
 EarthquakeService::~EarthquakeService() {
     stopService();
@@ -17,82 +249,385 @@ void EarthquakeService::startBackgroundService(int intervalSeconds) {
 }
 
 // NEW: API Server Implementation
-void EarthquakeService::startAPIServer(int port) {
-    // We detach the thread so it runs independently
-    std::thread([this, port]() {
-        httplib::Server svr;
-
-        // Define /status endpoint
-        svr.Get("/status", [this](const httplib::Request&, httplib::Response& res) {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            
-            // Create a JSON string manually (or use nlohmann::json)
-            std::string json = "{\"status\": \"running\", \"count\": " + std::to_string(m_quakes.size());
-            
-            if (!m_quakes.empty()) {
-                const auto& q = m_quakes[0];
-                json += ", \"latest\": {\"place\": \"" + q.place + "\", \"mag\": " + std::to_string(q.mag) + "}";
-            }
-            json += "}";
+void EarthquakeService::startAPIServer(int port, const ApiServerConfig& config) {
+    if (m_api) return;
+    auto api = std::make_unique<ApiServer>(config);
+    ApiServer& svr = *api;
+
+    // Define /status endpoint
+    svr.Get("/status", [this](const httplib::Request& req, httplib::Response& res) {
+        TRACE_SCOPE("GET /status");
+        auto snapshot = getSnapshot();
+        ServeCached(req, res, *snapshot, StatusKey, [&] {
+            return CachedResponse{"application/json", QuakeJson::Status(*snapshot)};
+        });
+    });
+
+    // Filtered, sorted, paged query served from the snapshot's indexes
+    svr.Get("/quakes", [this](const httplib::Request& req, httplib::Response& res) {
+        TRACE_SCOPE("GET /quakes");
+        std::map<std::string, std::string> params(req.params.begin(), req.params.end());
+        QuakeQuery query;
+        std::string error;
+        if (!QuakeQuery::Parse(params, query, error)) {
+            SendBadRequest(res, error);
+            return;
+        }
+
+        auto snapshot = getSnapshot();
+        auto format = QuakeBinary::Negotiate(req.get_header_value("Accept"));
+        std::string key = QuakesKey(query) + QuakeBinary::KeySuffix(format);
+        if (query.limit <= StreamThreshold) {
+            ServeCached(req, res, *snapshot, key, [&] {
+                QuakeQueryResult result = snapshot->index->Query(snapshot->quakes, query);
+                return Encoded(format,
+                    [&] { return QuakeJson::QueryResult(*snapshot, result, query); },
+                    [&] { return QuakeBinary::QueryResult(*snapshot, result, query); });
+            }, "Accept");
+            return;
+        }
+
+        // Export-sized page: a result of more than StreamThreshold rows is
+        // never cached. JSON is streamed; CBOR/MessagePack need the whole
+        // document, so they are built for this request and dropped after.
+        // Smaller results are cached like any other page.
+        bool gzip = false;
+        if (Revalidate(req, res, *snapshot, key, "Accept", gzip)) return;
+        QuakeQueryResult result = snapshot->index->Query(snapshot->quakes, query);
+        auto build = [&] {
+            return Encoded(format,
+                [&] { return QuakeJson::QueryResult(*snapshot, result, query); },
+                [&] { return QuakeBinary::QueryResult(*snapshot, result, query); });
+        };
+        if (result.items.size() <= StreamThreshold) {
+            SendCached(res, GetOrBuildEncoded(*snapshot->responses, key, gzip, build));
+        } else if (format == QuakeBinary::Format::Json) {
+            StreamQueryResult(res, snapshot, std::move(result), query, gzip);
+        } else {
+            SendCached(res, BuildEncoded(gzip, build));
+        }
+    });
+
+    // Delta sync: what changed since the version a client last saw. Clients
+    // pass back "epoch" too, since versions restart with the process; a
+    // version from another epoch, from the future, or one that aged out of
+    // the change log is answered with the full set ("full": true), cached
+    // once per snapshot under one key whatever `since` was.
+    svr.Get("/quakes/changes", [this](const httplib::Request& req, httplib::Response& res) {
+        TRACE_SCOPE("GET /quakes/changes");
+        unsigned long long since = 0, epoch = ProcessEpoch;
+        if (!ParseUnsigned(req.get_param_value("since"), since)) {
+            SendBadRequest(res, "since: expected a snapshot version");
+            return;
+        }
+        if (req.has_param("epoch") && !ParseUnsigned(req.get_param_value("epoch"), epoch)) {
+            SendBadRequest(res, "epoch: expected a number");
+            return;
+        }
+
+        auto snapshot = getSnapshot();
+        auto format = QuakeBinary::Negotiate(req.get_header_value("Accept"));
+        auto fullSync = [&] {
+            return Encoded(format,
+                [&] { return QuakeJson::FullSync(*snapshot, ProcessEpoch); },
+                [&] { return QuakeBinary::FullSync(*snapshot, ProcessEpoch); });
+        };
+        if (epoch != ProcessEpoch || !changeLogCovers(since, snapshot->version)) {
+            ServeCached(req, res, *snapshot, ChangesFullKey + std::string(QuakeBinary::KeySuffix(format)), fullSync, "Accept");
+            return;
+        }
+        std::string key = "/quakes/changes?since=" + std::to_string(since) + QuakeBinary::KeySuffix(format);
+        ServeCached(req, res, *snapshot, key, [&] {
+            QuakeChangeSet changes;
+            if (!getChangesSince(since, snapshot->version, changes)) return fullSync();
+            return Encoded(format,
+                [&] { return QuakeJson::Changes(*snapshot, ProcessEpoch, since, changes); },
+                [&] { return QuakeBinary::Changes(*snapshot, ProcessEpoch, since, changes); });
+        }, "Accept");
+    });
+
+    // Aggregates kept up to date by publish(); each answer re-bins a few
+    // hundred totals at most and is cached with the snapshot like /quakes
+    svr.Get("/stats/histogram", [this](const httplib::Request& req, httplib::Response& res) {
+        TRACE_SCOPE("GET /stats/histogram");
+        double width = 1.0;
+        if (req.has_param("width")) {
+            const std::string text = req.get_param_value("width");
+            char* end = nullptr;
+            width = std::strtod(text.c_str(), &end);
+            if (text.empty() || *end != '\0') width = 0;
+        }
+        long long tenths = std::llround(width * 10.0);
+        if (!(tenths >= 1 && tenths <= QuakeAggregates::MagBins && std::fabs(width * 10.0 - (double)tenths) < 1e-6)) {
+            SendBadRequest(res, "width: expected a multiple of 0.1 between 0.1 and 12");
+            return;
+        }
+
+        auto snapshot = getSnapshot();
+        ServeCached(req, res, *snapshot, "/stats/histogram?width=" + std::to_string(tenths), [&] {
+            return CachedResponse{"application/json",
+                QuakeJson::Histogram(*snapshot, (double)tenths / 10.0, snapshot->aggregates->Histogram((int)tenths))};
+        });
+    });
+
+    svr.Get("/stats/regions", [this](const httplib::Request& req, httplib::Response& res) {
+        TRACE_SCOPE("GET /stats/regions");
+        std::string sort = req.has_param("sort") ? req.get_param_value("sort") : "count";
+        unsigned long long limit = 0;
+        if (sort != "count" && sort != "mag") {
+            SendBadRequest(res, "sort: expected count or mag");
+            return;
+        }
+        if (req.has_param("limit") && !ParseUnsigned(req.get_param_value("limit"), limit)) {
+            SendBadRequest(res, "limit: expected a number");
+            return;
+        }
 
-            res.set_content(json, "application/json");
+        auto snapshot = getSnapshot();
+        ServeCached(req, res, *snapshot, "/stats/regions?sort=" + sort + "&limit=" + std::to_string(limit), [&] {
+            return CachedResponse{"application/json",
+                QuakeJson::Regions(*snapshot, snapshot->aggregates->TopRegions(sort == "mag", (size_t)limit))};
         });
+    });
 
-        std::cout << "Starting API Server on port " << port << "..." << std::endl;
-        svr.listen("0.0.0.0", port);
-    }).detach();
+    svr.Get("/stats/rate", [this](const httplib::Request& req, httplib::Response& res) {
+        TRACE_SCOPE("GET /stats/rate");
+        unsigned long long bucket = 3600, start = 0, end = (unsigned long long)LLONG_MAX;
+        if (req.has_param("bucket") && (!ParseUnsigned(req.get_param_value("bucket"), bucket) ||
+                                        bucket == 0 || bucket % 60 || bucket > 366ULL * 86400)) {
+            SendBadRequest(res, "bucket: expected seconds, a multiple of 60 up to a year");
+            return;
+        }
+        if ((req.has_param("start") && !ParseUnsigned(req.get_param_value("start"), start)) ||
+            (req.has_param("end") && !ParseUnsigned(req.get_param_value("end"), end))) {
+            SendBadRequest(res, "start, end: expected epoch milliseconds");
+            return;
+        }
+        start = std::min(start, (unsigned long long)LLONG_MAX);
+        end = std::min(end, (unsigned long long)LLONG_MAX);
+
+        auto snapshot = getSnapshot();
+        if (snapshot->aggregates->RateBuckets((long long)bucket * 1000, (long long)start, (long long)end) > QuakeAggregates::MaxRateBuckets) {
+            SendBadRequest(res, "too many buckets: use a larger bucket or a narrower start/end");
+            return;
+        }
+        std::string key = "/stats/rate?bucket=" + std::to_string(bucket) + "&start=" + std::to_string(start) +
+                          "&end=" + std::to_string(end);
+        ServeCached(req, res, *snapshot, key, [&] {
+            return CachedResponse{"application/json", QuakeJson::Rate(*snapshot, (long long)bucket * 1000,
+                snapshot->aggregates->Rate((long long)bucket * 1000, (long long)start, (long long)end))};
+        });
+    });
+
+    // Counters and histograms of the whole process in Prometheus text format
+    svr.Get("/metrics", [](const httplib::Request&, httplib::Response& res) {
+        res.set_content(Metrics::Expose(), "text/plain; version=0.0.4");
+    });
+
+    // Chrome trace JSON of every instrumented thread, for chrome://tracing.
+    // Several MB and internal detail, so opt-in and local callers only.
+    if (config.debugTrace) {
+        svr.Get("/debug/trace", [](const httplib::Request& req, httplib::Response& res) {
+            bool loopback = req.remote_addr.rfind("127.", 0) == 0 || req.remote_addr == "::1" || req.remote_addr.rfind("::ffff:127.", 0) == 0;
+            if (!loopback) {
+                res.status = 403;
+                res.set_content("{\"error\": \"/debug/trace is only served to loopback clients\"}", "application/json");
+                return;
+            }
+            res.set_content(Trace::Dump(), "application/json");
+        });
+    }
+
+    if (api->start(port)) m_api = std::move(api);
+}
+
+void EarthquakeService::startEventStream(int port) {
+    if (m_events) return;
+    auto events = std::make_unique<EventStreamServer>();
+    if (events->start(port)) m_events = std::move(events);
 }
 
 void EarthquakeService::stopService() {
     m_running = false;
+    if (m_api) m_api->stop();
     if (m_thread.joinable()) {
         m_thread.join();
     }
+    // After the worker, so nothing publishes into a stopped stream
+    if (m_events) m_events->stop();
 }
 
 void EarthquakeService::setMinMagnitude(float mag) { m_minMag = mag; }
 void EarthquakeService::setSortByMag(bool enable) { m_sortByMag = enable; }
+void EarthquakeService::setOnPublish(std::function<void()> callback) { m_onPublish = std::move(callback); }
 
 std::vector<Earthquake> EarthquakeService::getQuakes() {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_quakes;
+    return getSnapshot()->quakes;
+}
+
+std::shared_ptr<const QuakeSnapshot> EarthquakeService::getSnapshot() {
+    return std::atomic_load(&m_snapshot);
+}
+
+bool EarthquakeService::changeLogCovers(uint64_t since, uint64_t upTo) {
+    if (since == upTo) return true;
+    if (since > upTo) return false;
+    auto lock = Trace::Lock(m_changeLogMutex, "wait EarthquakeService::m_changeLogMutex");
+    return !m_changeLog.empty() && m_changeLog.front().version <= since + 1 && m_changeLog.back().version >= upTo;
+}
+
+bool EarthquakeService::getChangesSince(uint64_t since, uint64_t upTo, QuakeChangeSet& out) {
+    out = QuakeChangeSet();
+    if (since == upTo) return true;
+    if (since > upTo) return false;
+
+    std::vector<std::shared_ptr<const QuakeChangeSet>> window;
+    {
+        auto lock = Trace::Lock(m_changeLogMutex, "wait EarthquakeService::m_changeLogMutex");
+        if (m_changeLog.empty() || m_changeLog.front().version > since + 1 || m_changeLog.back().version < upTo) return false;
+        window.reserve((size_t)(upTo - since));
+        for (const auto& entry : m_changeLog) {
+            if (entry.version > since && entry.version <= upTo) window.push_back(entry.changes);
+        }
+    }
+
+    // Replay the window, remembering per id whether it existed at `since`
+    // and its latest value (null once removed)
+    struct Net {
+        bool existed;
+        const Earthquake* value;
+    };
+    std::unordered_map<std::string, Net> net;
+    std::vector<const std::string*> order;   // first-seen order keeps the output stable
+    auto touch = [&](const std::string& id, bool existed, const Earthquake* value) {
+        auto [it, added] = net.emplace(id, Net{existed, value});
+        if (added) order.push_back(&it->first);
+        else it->second.value = value;
+    };
+    for (const auto& changes : window) {
+        for (const auto& q : changes->inserted) touch(q.id, false, &q);
+        for (const auto& q : changes->updated) touch(q.id, true, &q);
+        for (const auto& id : changes->removed) touch(id, true, nullptr);
+    }
+
+    for (const std::string* id : order) {
+        const Net& n = net[*id];
+        if (n.value && n.existed) out.updated.push_back(*n.value);
+        else if (n.value) out.inserted.push_back(*n.value);
+        else if (n.existed) out.removed.push_back(*id);
+    }
+    return true;
 }
 
 std::string EarthquakeService::getStatus() {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    auto lock = Trace::Lock(m_mutex, "wait EarthquakeService::m_mutex");
     return m_status;
 }
 
 void EarthquakeService::fetchNow() {
+    TRACE_SCOPE("EarthquakeService::fetchNow");
     {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        auto lock = Trace::Lock(m_mutex, "wait EarthquakeService::m_mutex");
         m_status = "Fetching...";
     }
 
     httplib::Client cli("earthquake.usgs.gov", 443);
     cli.set_follow_location(true);
+    int interval = std::max(1, m_interval.load());
+    cli.set_connection_timeout(std::min(FetchConnectTimeoutSec, interval));
+    cli.set_read_timeout(std::min(FetchReadTimeoutSec, interval));
 
-    auto res = cli.Get("/earthquakes/feed/v1.0/summary/all_day.geojson");
+    const ServiceMetrics& metrics = Ingest();
+    httplib::Result res;
+    {
+        TRACE_SCOPE("USGS GET all_day.geojson");
+        Metrics::Timer timer(metrics.download);
+        res = cli.Get("/earthquakes/feed/v1.0/summary/all_day.geojson");
+    }
 
     if (res && res->status == 200) {
-        auto parsed = parseGeoJSON(res->body);
-        
-        if (m_sortByMag) {
-            std::sort(parsed.begin(), parsed.end(), [](const Earthquake& a, const Earthquake& b) {
-                return a.mag > b.mag;
-            });
+        metrics.bytes.Add((double)res->body.size());
+        std::vector<Earthquake> parsed;
+        {
+            Metrics::Timer timer(metrics.parse);
+            parsed = parseGeoJSON(res->body, m_minMag.load());
         }
-
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_quakes = std::move(parsed);
-        m_status = "Updated: " + std::to_string(m_quakes.size()) + " quakes";
+        Metrics::Timer timer(metrics.publish);
+        publish(std::move(parsed));
     } else {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        metrics.failures.Add();
+        auto lock = Trace::Lock(m_mutex, "wait EarthquakeService::m_mutex");
         m_status = "Error: Connection failed";
     }
+    // Status text changes on every fetch, so listeners hear about all of them
+    if (m_onPublish) m_onPublish();
+}
+
+void EarthquakeService::publish(std::vector<Earthquake> parsed) {
+    if (m_sortByMag) {
+        std::sort(parsed.begin(), parsed.end(), [](const Earthquake& a, const Earthquake& b) {
+            return a.mag > b.mag;
+        });
+    }
+
+    // Serialize publishers (worker + "Refresh Now") so versions stay linear
+    auto publishLock = Trace::Lock(m_publishMutex, "wait EarthquakeService::m_publishMutex");
+    auto previous = getSnapshot();
+    auto snapshot = std::make_shared<QuakeSnapshot>();
+    {
+        TRACE_SCOPE("EarthquakeService::diffQuakes");
+        snapshot->changes = diffQuakes(previous->quakes, parsed);
+    }
+    snapshot->quakes = std::move(parsed);
+    snapshot->version = previous->version + 1;
+    // Unchanged feed: keep the current version so readers skip the work
+    bool changed = !snapshot->changes.empty();
+    if (changed) {
+        {
+            auto lock = Trace::Lock(m_changeLogMutex, "wait EarthquakeService::m_changeLogMutex");
+            auto logged = std::make_shared<const QuakeChangeSet>(snapshot->changes);
+            m_changeLogEvents += logged->inserted.size() + logged->updated.size() + logged->removed.size();
+            m_changeLog.push_back({snapshot->version, std::move(logged)});
+            while (m_changeLog.size() > ChangeLogVersions ||
+                   (m_changeLog.size() > 1 && m_changeLogEvents > ChangeLogMaxEvents)) {
+                const QuakeChangeSet& oldest = *m_changeLog.front().changes;
+                m_changeLogEvents -= oldest.inserted.size() + oldest.updated.size() + oldest.removed.size();
+                m_changeLog.pop_front();
+            }
+        }
+
+        // Built before publishing so request threads never see a partial
+        // index, and the hot responses are ready for the first poll
+        TRACE_SCOPE("QuakeIndex build");
+        snapshot->index = std::make_shared<QuakeIndex>(snapshot->quakes);
+        m_aggregator->Apply(snapshot->changes);
+        snapshot->aggregates = m_aggregator->Publish();
+        snapshot->responses = std::make_shared<ResponseCache>();
+        snapshot->responses->GetOrBuild(StatusKey, [&] {
+            return CachedResponse{"application/json", QuakeJson::Status(*snapshot)};
+        });
+        QuakeQuery query;
+        GetOrBuildEncoded(*snapshot->responses, QuakesKey(query), true, [&] {
+            return CachedResponse{"application/json", QuakeJson::QueryResult(*snapshot, snapshot->index->Query(snapshot->quakes, query), query)};
+        });
+        const ServiceMetrics& metrics = Ingest();
+        metrics.inserted.Add((double)snapshot->changes.inserted.size());
+        metrics.updated.Add((double)snapshot->changes.updated.size());
+        metrics.removed.Add((double)snapshot->changes.removed.size());
+        metrics.version.Set((double)snapshot->version);
+        metrics.quakes.Set((double)snapshot->quakes.size());
+
+        std::shared_ptr<const QuakeSnapshot> published = std::move(snapshot);
+        std::atomic_store(&m_snapshot, published);
+        if (m_events) m_events->publish(std::move(published));
+    }
+
+    auto lock = Trace::Lock(m_mutex, "wait EarthquakeService::m_mutex");
+    m_status = "Updated: " + std::to_string(getSnapshot()->quakes.size()) + " quakes";
 }
 
 void EarthquakeService::workerLoop() {
+    Trace::SetThreadName("EarthquakeService worker");
     while (m_running) {
         fetchNow();
         int sleepTime = m_interval.load() * 10; 
@@ -102,14 +637,38 @@ void EarthquakeService::workerLoop() {
     }
 }
 
-std::vector<Earthquake> EarthquakeService::parseGeoJSON(const std::string& body) {
+QuakeChangeSet EarthquakeService::diffQuakes(const std::vector<Earthquake>& before, const std::vector<Earthquake>& after) {
+    QuakeChangeSet changes;
+    std::unordered_map<std::string, const Earthquake*> old;
+    old.reserve(before.size());
+    for (const auto& q : before) old[q.id] = &q;
+
+    for (const auto& q : after) {
+        auto it = old.find(q.id);
+        if (it == old.end()) {
+            changes.inserted.push_back(q);
+            continue;
+        }
+        const Earthquake& o = *it->second;
+        if (o.mag != q.mag || o.place != q.place || o.time_ms != q.time_ms ||
+            o.lon != q.lon || o.lat != q.lat || o.depth_km != q.depth_km) {
+            changes.updated.push_back(q);
+        }
+        old.erase(it);
+    }
+    for (const auto& [id, q] : old) changes.removed.push_back(id);
+    return changes;
+}
+
+std::vector<Earthquake> EarthquakeService::parseGeoJSON(const std::string& body, float minM) {
+    TRACE_SCOPE("EarthquakeService::parseGeoJSON");
     std::vector<Earthquake> results;
     using json = nlohmann::json;
 
     try {
         auto j = json::parse(body);
         if (!j.contains("features") || !j["features"].is_array()) return results;
-        float minM = m_minMag.load();
+        Ingest().features.Add((double)j["features"].size());
 
         for (const auto& f : j["features"]) {
             Earthquake e;
@@ -128,6 +687,8 @@ std::vector<Earthquake> EarthquakeService::parseGeoJSON(const std::string& body)
                 }
             }
             if (f.contains("id")) e.id = f["id"].get<std::string>();
+            TimeFormat::FormatUTC(e.time_ms, e.timeUtc);
+            TimeFormat::FormatLocal(e.time_ms, e.timeLocal);
 
             if (e.mag >= minM) results.push_back(e);
         }
@@ -6,7 +6,19 @@
 #include <atomic>
 #include <thread>
 #include <algorithm>
+#include <memory>
+#include <deque>
+#include <cstdint>
+#include <functional>
 #include "json.hpp" 
+#include "TimeFormat.h"
+#include "ApiServer.h"
+
+class QuakeIndex;
+struct QuakeAggregates;
+class QuakeAggregator;
+class ResponseCache;
+class EventStreamServer;
 
 struct Earthquake {
     std::string id;
@@ -16,33 +28,100 @@ struct Earthquake {
     double lon = 0.0;
     double lat = 0.0;
     double depth_km = 0.0;
+
+    // Display strings, formatted once at ingest
+    char timeUtc[TimeFormat::BufferSize] = "";
+    char timeLocal[TimeFormat::BufferSize] = "";
+};
+
+// Difference between a snapshot and the one published before it.
+struct QuakeChangeSet {
+    std::vector<Earthquake> inserted;
+    std::vector<Earthquake> updated;     // new values of changed events
+    std::vector<std::string> removed;    // ids no longer in the feed
+
+    bool empty() const { return inserted.empty() && updated.empty() && removed.empty(); }
+};
+
+// Immutable view of the data published by one fetch. It is swapped in
+// atomically and held by shared_ptr, so readers never copy the vector
+// and never take m_mutex.
+struct QuakeSnapshot {
+    uint64_t version = 0;
+    std::vector<Earthquake> quakes;
+    QuakeChangeSet changes;              // relative to version - 1
+    std::shared_ptr<const QuakeIndex> index;        // query indexes over `quakes`
+    std::shared_ptr<const QuakeAggregates> aggregates;   // /stats totals over `quakes`
+    std::shared_ptr<ResponseCache> responses;       // API bodies serialized from this version
 };
 
 class EarthquakeService {
 public:
+    // Bounds of the change log behind GET /quakes/changes
+    static constexpr size_t ChangeLogVersions = 256;
+    static constexpr size_t ChangeLogMaxEvents = 100000;
+
+    // /quakes pages with more results than this are never cached: JSON is
+    // streamed in chunks of StreamBatch quakes, binary formats built per request
+    static constexpr size_t StreamThreshold = 2000;
+    static constexpr size_t StreamBatch = 500;
+
+    // USGS fetch timeouts (each capped at the fetch interval), so a stalled
+    // download cannot hold up stopService() for httplib's 300 s defaults
+    static constexpr int FetchConnectTimeoutSec = 5;
+    static constexpr int FetchReadTimeoutSec = 5;
+
     EarthquakeService();
     ~EarthquakeService();
 
     void startBackgroundService(int intervalSeconds);
     
     // NEW: API Server function
-    void startAPIServer(int port);
+    void startAPIServer(int port, const ApiServerConfig& config = ApiServerConfig());
+
+    // Server-Sent Events of inserts/updates on its own port (GET /events/stream).
+    // Call before startBackgroundService().
+    void startEventStream(int port);
 
+    // Stops the fetch loop, the API server and the event stream and joins their threads.
     void stopService();
     void fetchNow();
 
+    // Publish a new data set (diffed against the current one). fetchNow()
+    // uses it after parsing; tools and benchmarks can feed fixtures directly.
+    void publish(std::vector<Earthquake> quakes);
+
     std::vector<Earthquake> getQuakes();
+    std::shared_ptr<const QuakeSnapshot> getSnapshot();
     std::string getStatus();
 
+    // Net changes from version `since` to version `upTo`, collapsed per id
+    // (inserted then removed cancels out, removed then re-inserted is an
+    // update). False when those versions are no longer in the change log.
+    bool getChangesSince(uint64_t since, uint64_t upTo, QuakeChangeSet& out);
+
+    // Whether getChangesSince(since, upTo) can be answered from the change log.
+    bool changeLogCovers(uint64_t since, uint64_t upTo);
+
     void setMinMagnitude(float mag);
     void setSortByMag(bool enable);
 
+    // Called from the fetching thread after a new snapshot is published.
+    // Set it before startBackgroundService().
+    void setOnPublish(std::function<void()> callback);
+
+    // USGS GeoJSON feed -> events with mag >= minMag. Malformed input yields
+    // whatever parsed before the error.
+    static std::vector<Earthquake> parseGeoJSON(const std::string& jsonBody, float minMag = 0.0f);
+
 private:
     void workerLoop(); 
-    std::vector<Earthquake> parseGeoJSON(const std::string& jsonBody);
+    static QuakeChangeSet diffQuakes(const std::vector<Earthquake>& before, const std::vector<Earthquake>& after);
 
-    std::mutex m_mutex;
-    std::vector<Earthquake> m_quakes;
+    std::mutex m_mutex;                              // guards m_status
+    std::mutex m_publishMutex;
+    std::unique_ptr<QuakeAggregator> m_aggregator;   // guarded by m_publishMutex
+    std::shared_ptr<const QuakeSnapshot> m_snapshot; // std::atomic_load / atomic_store only
     std::string m_status = "Idle";
 
     std::atomic<bool> m_running{false};
@@ -50,5 +129,17 @@ private:
     std::atomic<float> m_minMag{0.0f};
     std::atomic<bool> m_sortByMag{true};
     
+    struct ChangeLogEntry {
+        uint64_t version;
+        std::shared_ptr<const QuakeChangeSet> changes;   // relative to version - 1
+    };
+    std::mutex m_changeLogMutex;
+    std::deque<ChangeLogEntry> m_changeLog;          // consecutive versions, oldest first
+    size_t m_changeLogEvents = 0;
+
     std::thread m_thread;
+    std::function<void()> m_onPublish;
+
+    std::unique_ptr<ApiServer> m_api;
+    std::unique_ptr<EventStreamServer> m_events;
 };
\ No newline at end of file
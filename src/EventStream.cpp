@@ -0,0 +1,421 @@
+#include "EventStream.h"
+#include "QuakeJson.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0   // macOS: SO_NOSIGPIPE is set per socket instead
+#endif
+
+namespace {
+
+const char* StreamPath = "/events/stream";
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::string UrlDecode(const std::string& s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '+') out += ' ';
+        else if (s[i] == '%' && i + 2 < s.size() && HexValue(s[i + 1]) >= 0 && HexValue(s[i + 2]) >= 0) {
+            out += (char)(HexValue(s[i + 1]) * 16 + HexValue(s[i + 2]));
+            i += 2;
+        } else out += s[i];
+    }
+    return out;
+}
+
+std::map<std::string, std::string> ParseQueryString(const std::string& qs) {
+    std::map<std::string, std::string> params;
+    size_t pos = 0;
+    while (pos < qs.size()) {
+        size_t amp = qs.find('&', pos);
+        if (amp == std::string::npos) amp = qs.size();
+        std::string pair = qs.substr(pos, amp - pos);
+        size_t eq = pair.find('=');
+        if (!pair.empty()) {
+            params[UrlDecode(pair.substr(0, eq))] = eq == std::string::npos ? "" : UrlDecode(pair.substr(eq + 1));
+        }
+        pos = amp + 1;
+    }
+    return params;
+}
+
+// Value of header `name` (case-insensitive) in a raw request head, or ""
+std::string HeaderValue(const std::string& head, const char* name) {
+    size_t nameLen = std::strlen(name);
+    size_t pos = head.find("\r\n");
+    while (pos != std::string::npos && pos + 2 < head.size()) {
+        size_t start = pos + 2;
+        size_t end = head.find("\r\n", start);
+        if (end == std::string::npos) end = head.size();
+        if (end - start > nameLen && head[start + nameLen] == ':' &&
+            std::equal(name, name + nameLen, head.begin() + (long)start,
+                       [](char a, char b) { return std::tolower((unsigned char)a) == std::tolower((unsigned char)b); })) {
+            size_t v = head.find_first_not_of(' ', start + nameLen + 1);
+            return v < end ? head.substr(v, end - v) : "";
+        }
+        pos = end;
+    }
+    return "";
+}
+
+uint64_t NowMs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+// Ids start from the wall clock, so ids handed out by an earlier process
+// are always older than this log and resume as a reset, never a wrong replay.
+EventStreamServer::EventStreamServer() : m_nextId(NowMs() * 1000) {}
+
+EventStreamServer::~EventStreamServer() {
+    stop();
+}
+
+void EventStreamServer::publish(std::shared_ptr<const QuakeSnapshot> snapshot) {
+    if (!m_running) return;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        m_pending.push_back(std::move(snapshot));
+    }
+#ifndef _WIN32
+    char b = 1;
+    (void)!write(m_wakeWrite, &b, 1);
+#endif
+}
+
+#ifdef _WIN32
+
+bool EventStreamServer::start(int) {
+    std::cerr << "Event stream is not supported on this platform" << std::endl;
+    return false;
+}
+void EventStreamServer::stop() {}
+void EventStreamServer::loop() {}
+void EventStreamServer::acceptClients() {}
+void EventStreamServer::readFrom(Client&) {}
+void EventStreamServer::startStream(Client&, const std::string&) {}
+void EventStreamServer::enqueue(Client&, const std::string&) {}
+void EventStreamServer::flush(Client&) {}
+void EventStreamServer::drainPublished() {}
+
+#else
+
+bool EventStreamServer::start(int port) {
+    if (m_running) return true;
+
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    m_wakeRead = fds[0];
+    m_wakeWrite = fds[1];
+    fcntl(m_wakeRead, F_SETFL, O_NONBLOCK);
+    fcntl(m_wakeWrite, F_SETFL, O_NONBLOCK);
+
+    m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    if (m_listenFd < 0 || bind(m_listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(m_listenFd, 512) != 0) {
+        std::cerr << "Event stream failed to bind port " << port << std::endl;
+        if (m_listenFd >= 0) close(m_listenFd);
+        close(m_wakeRead);
+        close(m_wakeWrite);
+        m_listenFd = m_wakeRead = m_wakeWrite = -1;
+        return false;
+    }
+    fcntl(m_listenFd, F_SETFL, O_NONBLOCK);
+    m_spareFd = open("/dev/null", O_RDONLY);
+
+    // Each client is a descriptor: raise the soft limit toward the hard one
+    // and cap clients at whatever it allows
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        rlim_t wanted = (rlim_t)(MaxClients + ReservedFds);
+        if (limit.rlim_cur < wanted && limit.rlim_cur != RLIM_INFINITY) {
+            rlimit raised = limit;
+            raised.rlim_cur = limit.rlim_max == RLIM_INFINITY ? wanted : std::min(wanted, limit.rlim_max);
+            if (setrlimit(RLIMIT_NOFILE, &raised) == 0) limit = raised;
+        }
+        if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < wanted) {
+            m_maxClients = limit.rlim_cur > ReservedFds * 2 ? (size_t)limit.rlim_cur - ReservedFds : (size_t)limit.rlim_cur / 2;
+            std::cerr << "Event stream limited to " << m_maxClients << " clients by RLIMIT_NOFILE" << std::endl;
+        }
+    }
+
+    std::cout << "Starting event stream on port " << port << "..." << std::endl;
+    m_running = true;
+    m_thread = std::thread(&EventStreamServer::loop, this);
+    return true;
+}
+
+void EventStreamServer::stop() {
+    if (!m_running.exchange(false)) return;
+    char b = 0;
+    (void)!write(m_wakeWrite, &b, 1);
+    if (m_thread.joinable()) m_thread.join();
+
+    for (auto& c : m_clients) close(c->fd);
+    m_clients.clear();
+    m_clientCount = 0;
+    close(m_listenFd);
+    close(m_wakeRead);
+    close(m_wakeWrite);
+    if (m_spareFd >= 0) close(m_spareFd);
+    m_listenFd = m_wakeRead = m_wakeWrite = m_spareFd = -1;
+}
+
+void EventStreamServer::loop() {
+    Trace::SetThreadName("Event stream");
+    const Metrics::Gauge clients = Metrics::GetGauge("earthquake_sse_clients", "Connected event stream clients");
+    auto lastHeartbeat = std::chrono::steady_clock::now();
+    std::vector<pollfd> fds;
+
+    while (m_running) {
+        fds.clear();
+        fds.push_back({m_wakeRead, POLLIN, 0});
+        bool accepting = std::chrono::steady_clock::now() >= m_acceptResume;
+        fds.push_back({m_listenFd, (short)(accepting ? POLLIN : 0), 0});
+        for (auto& c : m_clients) {
+            short events = POLLIN;
+            if (c->outPos < c->out.size()) events |= POLLOUT;
+            fds.push_back({c->fd, events, 0});
+        }
+
+        if (poll(fds.data(), (nfds_t)fds.size(), 1000) < 0) continue;
+        if (!m_running) break;
+
+        if (fds[0].revents & POLLIN) {
+            char buf[256];
+            while (read(m_wakeRead, buf, sizeof(buf)) > 0) {}
+            drainPublished();
+        }
+        if (fds[1].revents & POLLIN) acceptClients();
+
+        // Clients accepted above have no pollfd yet; they are picked up next round
+        for (size_t i = 2; i < fds.size(); i++) {
+            Client& c = *m_clients[i - 2];
+            if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) { c.closing = true; continue; }
+            if (fds[i].revents & POLLIN) readFrom(c);
+            if (fds[i].revents & POLLOUT) flush(c);
+        }
+
+        // Keeps idle connections alive through proxies and finds dead peers
+        auto now = std::chrono::steady_clock::now();
+        for (auto& c : m_clients) {
+            if (!c->streaming && now - c->acceptedAt >= std::chrono::seconds(HeaderTimeoutSeconds)) c->closing = true;
+        }
+        if (now - lastHeartbeat >= std::chrono::seconds(HeartbeatSeconds)) {
+            lastHeartbeat = now;
+            for (auto& c : m_clients) {
+                if (c->streaming) { enqueue(*c, ": ping\n\n"); flush(*c); }
+            }
+        }
+
+        auto gone = std::remove_if(m_clients.begin(), m_clients.end(), [](const std::unique_ptr<Client>& c) {
+            if (c->closing) close(c->fd);
+            return c->closing;
+        });
+        m_clients.erase(gone, m_clients.end());
+        m_clientCount.store(m_clients.size(), std::memory_order_relaxed);
+        clients.Set((double)m_clients.size());
+    }
+}
+
+void EventStreamServer::acceptClients() {
+    while (true) {
+        int fd = accept(m_listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE) {
+                // The pending connection keeps the listener readable: free the
+                // spare descriptor to accept and close it, or pause accepting
+                static const Metrics::Counter shed = Metrics::GetCounter("earthquake_sse_shed_total", "Event stream connections closed for lack of file descriptors");
+                shed.Add();
+                if (m_spareFd >= 0) {
+                    close(m_spareFd);
+                    int pending = accept(m_listenFd, nullptr, nullptr);
+                    if (pending >= 0) close(pending);
+                    m_spareFd = open("/dev/null", O_RDONLY);
+                }
+                if (m_spareFd < 0) m_acceptResume = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+            }
+            return;   // EAGAIN: nothing left to accept
+        }
+        if (m_clients.size() >= m_maxClients) { close(fd); continue; }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        auto c = std::make_unique<Client>();
+        c->fd = fd;
+        c->acceptedAt = std::chrono::steady_clock::now();
+        m_clients.push_back(std::move(c));
+    }
+}
+
+void EventStreamServer::readFrom(Client& c) {
+    char buf[4096];
+    while (true) {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n == 0) { c.closing = true; return; }
+        if (n < 0) return;   // EAGAIN
+        // Streaming clients have nothing more to say; ignore whatever they send
+        if (c.streaming) continue;
+        c.in.append(buf, (size_t)n);
+        size_t headEnd = c.in.find("\r\n\r\n");
+        if (headEnd != std::string::npos) {
+            startStream(c, c.in.substr(0, headEnd + 2));
+            c.in.clear();
+            c.in.shrink_to_fit();
+        } else if (c.in.size() > 8192) {
+            c.closing = true;
+            return;
+        }
+    }
+}
+
+void EventStreamServer::startStream(Client& c, const std::string& head) {
+    auto reject = [&](const char* status, const std::string& body) {
+        enqueue(c, std::string("HTTP/1.1 ") + status + "\r\nContent-Type: application/json\r\nContent-Length: " +
+                   std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body);
+        flush(c);
+        c.closing = true;
+    };
+
+    // "GET /events/stream?minmag=4 HTTP/1.1"
+    size_t sp1 = head.find(' '), sp2 = head.find(' ', sp1 + 1);
+    if (head.compare(0, 4, "GET ") != 0 || sp2 == std::string::npos) { reject("400 Bad Request", "{\"error\": \"bad request\"}"); return; }
+    std::string target = head.substr(sp1 + 1, sp2 - sp1 - 1);
+    size_t q = target.find('?');
+    if (target.substr(0, q) != StreamPath) { reject("404 Not Found", "{\"error\": \"not found\"}"); return; }
+
+    auto params = ParseQueryString(q == std::string::npos ? "" : target.substr(q + 1));
+    std::string error;
+    if (!QuakeQuery::Parse(params, c.filter, error)) {
+        std::string body = "{\"error\": ";
+        QuakeJson::AppendString(body, error);
+        reject("400 Bad Request", body + "}");
+        return;
+    }
+
+    c.streaming = true;
+    enqueue(c, "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+               "Connection: keep-alive\r\nAccess-Control-Allow-Origin: *\r\n\r\nretry: 3000\n\n");
+
+    // Resume: header from EventSource reconnects, query param for manual clients
+    std::string lastId = HeaderValue(head, "Last-Event-ID");
+    if (lastId.empty() && params.count("lastEventId")) lastId = params["lastEventId"];
+    if (!lastId.empty()) {
+        char* end = nullptr;
+        unsigned long long last = std::strtoull(lastId.c_str(), &end, 10);
+        bool inLog = *end == '\0' && last + 1 >= m_nextId - m_log.size() && last < m_nextId;
+        if (inLog) {
+            for (const auto& e : m_log) {
+                if (e->id > last && c.filter.Matches(e->quake)) enqueue(c, e->wire);
+            }
+        } else {
+            enqueue(c, "event: reset\ndata: {\"version\":" + std::to_string(m_version) + "}\n\n");
+        }
+    }
+    flush(c);
+}
+
+void EventStreamServer::enqueue(Client& c, const std::string& data) {
+    if (c.closing) return;
+    if (c.out.size() - c.outPos + data.size() > MaxClientBacklog) {
+        // Too slow to keep up: drop it and let it resume via Last-Event-ID
+        static const Metrics::Counter dropped = Metrics::GetCounter("earthquake_sse_dropped_total", "Event stream clients disconnected for falling behind");
+        dropped.Add();
+        c.closing = true;
+        return;
+    }
+    if (c.outPos > 0 && c.outPos >= c.out.size() / 2) {
+        c.out.erase(0, c.outPos);
+        c.outPos = 0;
+    }
+    c.out += data;
+}
+
+void EventStreamServer::flush(Client& c) {
+    while (c.outPos < c.out.size()) {
+        ssize_t n = send(c.fd, c.out.data() + c.outPos, c.out.size() - c.outPos, MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            c.closing = true;
+            return;
+        }
+        c.outPos += (size_t)n;
+    }
+    c.out.clear();
+    c.outPos = 0;
+}
+
+void EventStreamServer::drainPublished() {
+    std::vector<std::shared_ptr<const QuakeSnapshot>> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        pending.swap(m_pending);
+    }
+
+    TRACE_SCOPE("EventStream fan-out");
+    std::vector<std::shared_ptr<const Event>> batch;
+    for (const auto& snapshot : pending) {
+        m_version = snapshot->version;
+        auto add = [&](const Earthquake& q, const char* type) {
+            auto e = std::make_shared<Event>();
+            e->id = m_nextId++;
+            e->quake = q;
+            e->wire = "id: " + std::to_string(e->id) + "\nevent: " + type + "\ndata: {\"version\":" +
+                      std::to_string(snapshot->version) + ",\"quake\":";
+            QuakeJson::AppendQuake(e->wire, q);
+            e->wire += "}\n\n";
+            batch.push_back(e);
+            m_log.push_back(std::move(e));
+            if (m_log.size() > LogSize) m_log.pop_front();
+        };
+        for (const auto& q : snapshot->changes.inserted) add(q, "insert");
+        for (const auto& q : snapshot->changes.updated) add(q, "update");
+    }
+
+    for (auto& c : m_clients) {
+        if (!c->streaming) continue;
+        for (const auto& e : batch) {
+            if (c->filter.Matches(e->quake)) enqueue(*c, e->wire);
+        }
+        flush(*c);
+    }
+}
+
+#endif
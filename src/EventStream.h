@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "EarthquakeService.h"
+#include "QuakeIndex.h"
+
+// Server-Sent Events push of inserted and updated quakes.
+//
+// One thread multiplexes every connection with poll(), so thousands of idle
+// subscribers cost a socket and a small struct each, not a thread. Each
+// event is serialized once and appended to the output buffer of every
+// client whose filter (the /quakes parameters) it passes. A client whose
+// unsent backlog exceeds MaxClientBacklog is disconnected; it reconnects
+// with Last-Event-ID and is replayed from the event log, or told to
+// resynchronize ("event: reset") when it fell out of the log.
+//
+// Connections that have not sent a complete request head within
+// HeaderTimeoutSeconds are closed, so idle sockets cannot hold every slot.
+// The client cap is lowered to what RLIMIT_NOFILE allows (after trying to
+// raise it), and running out of descriptors sheds the pending connection
+// through a spare fd instead of leaving the listener ready forever.
+class EventStreamServer {
+public:
+    static constexpr size_t LogSize = 8192;                 // events kept for resume
+    static constexpr size_t MaxClientBacklog = 256 * 1024;  // bytes queued per client
+    static constexpr size_t MaxClients = 10000;
+    static constexpr int HeartbeatSeconds = 15;
+    static constexpr int HeaderTimeoutSeconds = 10;
+    static constexpr size_t ReservedFds = 256;              // left for the API server, feed fetches, files
+
+    EventStreamServer();
+    ~EventStreamServer();
+
+    // Bind 0.0.0.0:port and start the event loop. Serves GET /events/stream.
+    bool start(int port);
+    void stop();
+
+    // Queue the changes of a newly published snapshot (any thread, non-blocking).
+    void publish(std::shared_ptr<const QuakeSnapshot> snapshot);
+
+    size_t clientCount() const { return m_clientCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Event {
+        uint64_t id;
+        Earthquake quake;      // kept for per-client filtering
+        std::string wire;      // complete "id/event/data" SSE message
+    };
+
+    struct Client {
+        int fd = -1;
+        bool streaming = false;
+        bool closing = false;
+        std::chrono::steady_clock::time_point acceptedAt;
+        std::string in;
+        std::string out;
+        size_t outPos = 0;
+        QuakeQuery filter;
+    };
+
+    void loop();
+    void acceptClients();
+    void readFrom(Client& c);
+    void startStream(Client& c, const std::string& request);
+    void enqueue(Client& c, const std::string& data);
+    void flush(Client& c);
+    void drainPublished();
+
+    int m_listenFd = -1;
+    int m_wakeRead = -1, m_wakeWrite = -1;
+    int m_spareFd = -1;                                  // given up to shed a connection at EMFILE
+    size_t m_maxClients = MaxClients;
+    std::chrono::steady_clock::time_point m_acceptResume;   // listener not polled before this
+    std::atomic<bool> m_running{false};
+    std::thread m_thread;
+
+    std::mutex m_pendingMutex;
+    std::vector<std::shared_ptr<const QuakeSnapshot>> m_pending;
+
+    // Loop thread only
+    std::vector<std::unique_ptr<Client>> m_clients;
+    std::deque<std::shared_ptr<const Event>> m_log;
+    uint64_t m_nextId;
+    uint64_t m_version = 0;
+
+    std::atomic<size_t> m_clientCount{0};
+};
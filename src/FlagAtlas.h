@@ -0,0 +1,103 @@
+#pragma once
+#include "imgui.h"
+#include "GLHeaders.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+
+// Packs every flag into a few fixed-size atlas pages, so a list of flags
+// is drawn from one texture (ImGui merges the draw commands) instead of
+// one texture bind per row. GPU memory is capped at MaxPages pages.
+class FlagAtlas {
+public:
+    static constexpr int PageWidth = 1024;
+    static constexpr int PageHeight = 512;
+    static constexpr int SlotWidth = 82;   // 80 px flag + 1 px padding each side
+    static constexpr int SlotHeight = 62;
+    static constexpr int MaxPages = 2;
+
+    struct Sprite {
+        ImTextureID texture = 0;
+        ImVec2 uv0, uv1;
+    };
+
+    bool Contains(const std::string& key) const { return m_sprites.count(key) != 0; }
+
+    const Sprite* Find(const std::string& key) const {
+        auto it = m_sprites.find(key);
+        return it == m_sprites.end() ? nullptr : &it->second;
+    }
+
+    // Copy an RGBA image into the next free slot (render thread only).
+    // Images larger than a slot are downscaled, keeping their aspect ratio.
+    bool Add(const std::string& key, const unsigned char* rgba, int width, int height) {
+        if (Contains(key) || width <= 0 || height <= 0) return Contains(key);
+
+        const int cols = PageWidth / SlotWidth, rows = PageHeight / SlotHeight;
+        const int slotsPerPage = cols * rows;
+        int page = m_used / slotsPerPage;
+        if (page >= MaxPages) {
+            std::cerr << "Flag atlas full, skipping " << key << std::endl;
+            return false;
+        }
+        if (page == (int)m_pages.size()) m_pages.push_back(CreatePage());
+
+        int slot = m_used % slotsPerPage;
+        int x = (slot % cols) * SlotWidth + 1;
+        int y = (slot / cols) * SlotHeight + 1;
+
+        float scale = std::min(1.0f, std::min((SlotWidth - 2) / (float)width, (SlotHeight - 2) / (float)height));
+        int w = std::max(1, (int)(width * scale));
+        int h = std::max(1, (int)(height * scale));
+
+        m_scratch.resize((size_t)w * h * 4);
+        for (int py = 0; py < h; py++) {
+            const unsigned char* src = rgba + (size_t)(py * height / h) * width * 4;
+            unsigned char* dst = m_scratch.data() + (size_t)py * w * 4;
+            for (int px = 0; px < w; px++) {
+                const unsigned char* s = src + (size_t)(px * width / w) * 4;
+                dst[px * 4 + 0] = s[0]; dst[px * 4 + 1] = s[1];
+                dst[px * 4 + 2] = s[2]; dst[px * 4 + 3] = s[3];
+            }
+        }
+
+        glBindTexture(GL_TEXTURE_2D, m_pages[page]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, m_scratch.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        Sprite& s = m_sprites[key];
+        s.texture = (ImTextureID)(intptr_t)m_pages[page];
+        s.uv0 = ImVec2(x / (float)PageWidth, y / (float)PageHeight);
+        s.uv1 = ImVec2((x + w) / (float)PageWidth, (y + h) / (float)PageHeight);
+        m_used++;
+        return true;
+    }
+
+    // Draw the flag inline; returns false (and draws nothing) if not loaded yet.
+    bool Image(const std::string& key, const ImVec2& size) const {
+        const Sprite* s = Find(key);
+        if (!s) return false;
+        ImGui::Image(s->texture, size, s->uv0, s->uv1);
+        return true;
+    }
+
+private:
+    static GLuint CreatePage() {
+        std::vector<unsigned char> clear((size_t)PageWidth * PageHeight * 4, 0);
+        GLuint tex;
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, PageWidth, PageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, clear.data());
+        return tex;
+    }
+
+    std::vector<GLuint> m_pages;
+    std::unordered_map<std::string, Sprite> m_sprites;
+    std::vector<unsigned char> m_scratch;
+    int m_used = 0;
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include "imgui.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+// Per-section CPU timings of the render loop, kept in ring buffers of the
+// last HistorySize frames and shown as an overlay with percentiles.
+class FrameProfiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum Section {
+        SnapshotAcquire, Filter, RegionStats, Histogram, MapLayers, MapDraw, TableBuild, ImGuiRender, Swap,
+        SectionCount
+    };
+    static constexpr int HistorySize = 240;
+
+    // RAII timer for one section; sections may run several times per frame.
+    // Each one is also recorded as a Trace event for the timeline export.
+    class Scope {
+    public:
+        Scope(FrameProfiler& p, Section s) : m_profiler(p), m_section(s), m_start(Clock::now()) {}
+        ~Scope() {
+            Clock::time_point end = Clock::now();
+            m_profiler.m_current[m_section] += Ms(end - m_start);
+            Trace::Record(Name(m_section), m_start, end);
+        }
+    private:
+        FrameProfiler& m_profiler;
+        Section m_section;
+        Clock::time_point m_start;
+    };
+
+    void BeginFrame() {
+        m_frameStart = Clock::now();
+        std::fill(std::begin(m_current), std::end(m_current), 0.0f);
+    }
+
+    void EndFrame() {
+        for (int s = 0; s < SectionCount; s++) m_history[s][m_cursor] = m_current[s];
+        m_frameHistory[m_cursor] = Ms(Clock::now() - m_frameStart);
+        m_frameMetric.Observe(m_frameHistory[m_cursor] / 1000.0);
+        m_cursor = (m_cursor + 1) % HistorySize;
+        if (m_filled < HistorySize) m_filled++;
+    }
+
+    float LastFrameMs() const { return m_frameHistory[(m_cursor + HistorySize - 1) % HistorySize]; }
+
+    void DrawOverlay(bool* open) {
+        ImGui::SetNextWindowBgAlpha(0.85f);
+        ImGui::SetNextWindowPos(ImVec2(340, 320), ImGuiCond_FirstUseEver);
+        if (!ImGui::Begin("Frame Profiler (F1)", open, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing)) {
+            ImGui::End();
+            return;
+        }
+
+        // Plot oldest -> newest
+        float ordered[HistorySize];
+        for (int i = 0; i < HistorySize; i++) ordered[i] = m_frameHistory[(m_cursor + i) % HistorySize];
+        float p50 = Percentile(m_frameHistory, 0.50f), p99 = Percentile(m_frameHistory, 0.99f);
+        ImGui::Text("Frame: p50 %.2f ms  p99 %.2f ms  (%d frames)", p50, p99, m_filled);
+        ImGui::PlotLines("##Frame", ordered, HistorySize, 0, nullptr, 0.0f, std::max(16.7f, p99 * 1.2f), ImVec2(360, 60));
+
+        if (ImGui::BeginTable("Sections", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+            ImGui::TableSetupColumn("Section", 0, 120); ImGui::TableSetupColumn("Last", 0, 55);
+            ImGui::TableSetupColumn("p50", 0, 55); ImGui::TableSetupColumn("p95", 0, 55); ImGui::TableSetupColumn("p99", 0, 55);
+            ImGui::TableHeadersRow();
+            for (int s = 0; s < SectionCount; s++) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(Name((Section)s));
+                ImGui::TableNextColumn(); ImGui::Text("%.3f", m_history[s][(m_cursor + HistorySize - 1) % HistorySize]);
+                ImGui::TableNextColumn(); ImGui::Text("%.3f", Percentile(m_history[s], 0.50f));
+                ImGui::TableNextColumn(); ImGui::Text("%.3f", Percentile(m_history[s], 0.95f));
+                ImGui::TableNextColumn(); ImGui::Text("%.3f", Percentile(m_history[s], 0.99f));
+            }
+            ImGui::EndTable();
+        }
+        ImGui::TextDisabled("CPU ms per frame; cached sections read 0 when skipped.");
+        ImGui::End();
+    }
+
+    static const char* Name(Section s) {
+        static const char* names[SectionCount] = {
+            "Snapshot acquire", "Filter", "Region stats", "Histogram", "Map layers", "Map draw", "Table build", "ImGui render",
+            "Swap"
+        };
+        return names[s];
+    }
+
+private:
+    static float Ms(Clock::duration d) { return std::chrono::duration<float, std::milli>(d).count(); }
+
+    float Percentile(const float* ring, float q) const {
+        if (m_filled == 0) return 0.0f;
+        // Newest m_filled samples end just before the cursor
+        std::vector<float>& tmp = m_scratch;
+        tmp.clear();
+        for (int i = 0; i < m_filled; i++) tmp.push_back(ring[(m_cursor + HistorySize - 1 - i) % HistorySize]);
+        size_t k = std::min(tmp.size() - 1, (size_t)(q * (tmp.size() - 1) + 0.5f));
+        std::nth_element(tmp.begin(), tmp.begin() + k, tmp.end());
+        return tmp[k];
+    }
+
+    float m_current[SectionCount] = {};
+    float m_history[SectionCount][HistorySize] = {};
+    float m_frameHistory[HistorySize] = {};
+    int m_cursor = 0;
+    int m_filled = 0;
+    Clock::time_point m_frameStart;
+    Metrics::Histogram m_frameMetric = Metrics::GetHistogram("earthquake_frame_seconds", "GUI frame time, CPU side");
+    mutable std::vector<float> m_scratch;
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <GLFW/glfw3.h>
+
+// Decides how the render loop waits between frames. While something is
+// animating it polls (vsync paced); otherwise it blocks in
+// glfwWaitEventsTimeout until input, a Wake() from a worker thread or the
+// idle timeout, then renders a few frames so ImGui can settle hover and
+// layout state. A minimized window blocks until it is restored.
+class FrameScheduler {
+public:
+    static constexpr double IdleTimeout = 2.0;  // seconds between idle refreshes
+    static constexpr int SettleFrames = 3;
+
+    void WaitForNextFrame(GLFWwindow* window, bool animating) {
+        while (glfwGetWindowAttrib(window, GLFW_ICONIFIED) && !glfwWindowShouldClose(window)) {
+            glfwWaitEvents();
+            m_settle = SettleFrames;
+        }
+
+        if (animating || m_settle > 0) {
+            glfwPollEvents();
+            if (m_settle > 0) m_settle--;
+        } else {
+            glfwWaitEventsTimeout(IdleTimeout);
+            m_settle = SettleFrames - 1;
+        }
+    }
+
+    // Thread-safe: wake the render loop (new snapshot, finished asset, ...)
+    static void Wake() { glfwPostEmptyEvent(); }
+
+private:
+    int m_settle = SettleFrames;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+// Core-profile OpenGL 3.x declarations for our own GL code (mipmaps,
+// buffers, shaders). macOS ships them in gl3.h; on other platforms libGL
+// exports them and glcorearb.h just needs the prototypes enabled.
+#if !defined(__APPLE__) && !defined(GL_GLEXT_PROTOTYPES)
+#define GL_GLEXT_PROTOTYPES
+#endif
+#define GLFW_INCLUDE_GLCOREARB
+#include <GLFW/glfw3.h>
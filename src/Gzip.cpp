@@ -0,0 +1,58 @@
+#include "Gzip.h"
+#include "AcceptList.h"
+#include <zlib.h>
+
+std::string Gzip::Compress(const std::string& data, int level) {
+    z_stream zs{};
+    // 15 window bits + 16 selects the gzip wrapper instead of raw zlib
+    if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return {};
+
+    std::string out;
+    out.resize(deflateBound(&zs, (uLong)data.size()));
+    zs.next_in = (Bytef*)data.data();
+    zs.avail_in = (uInt)data.size();
+    zs.next_out = (Bytef*)&out[0];
+    zs.avail_out = (uInt)out.size();
+    int rc = deflate(&zs, Z_FINISH);
+    size_t written = zs.total_out;
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END) return {};
+    out.resize(written);
+    return out;
+}
+
+bool Gzip::Accepted(const std::string& header) {
+    bool gzip = false, wildcard = false, gzipListed = false;
+    for (const auto& entry : AcceptList::Parse(header)) {
+        if (entry.value == "gzip" || entry.value == "x-gzip") { gzipListed = true; gzip = entry.q > 0; }
+        else if (entry.value == "*") wildcard = entry.q > 0;
+    }
+    // An explicit "gzip;q=0" wins over "*"
+    return gzipListed ? gzip : wildcard;
+}
+
+GzipStream::GzipStream(int level) : m_zs(std::make_unique<z_stream>()) {
+    m_ok = deflateInit2(m_zs.get(), level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+GzipStream::~GzipStream() {
+    if (m_ok) deflateEnd(m_zs.get());
+}
+
+bool GzipStream::Write(const std::string& data, bool finish, std::string& out) {
+    out.clear();
+    if (!m_ok) return false;
+    m_zs->next_in = (Bytef*)data.data();
+    m_zs->avail_in = (uInt)data.size();
+    int flush = finish ? Z_FINISH : Z_SYNC_FLUSH;
+    char buf[16384];
+    int rc;
+    do {
+        m_zs->next_out = (Bytef*)buf;
+        m_zs->avail_out = sizeof(buf);
+        rc = deflate(m_zs.get(), flush);
+        if (rc == Z_STREAM_ERROR) return false;
+        out.append(buf, sizeof(buf) - m_zs->avail_out);
+    } while (m_zs->avail_out == 0 || (finish && rc != Z_STREAM_END));
+    return true;
+}
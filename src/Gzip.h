@@ -0,0 +1,37 @@
+#pragma once
+#include <memory>
+#include <string>
+
+struct z_stream_s;
+
+// gzip for API responses. Bodies are compressed once per snapshot and
+// cached, so the level favours size over speed.
+class Gzip {
+public:
+    static constexpr int Level = 6;
+    static constexpr size_t MinSize = 1024;   // smaller bodies go out as-is
+
+    // gzip stream of `data`; empty on failure
+    static std::string Compress(const std::string& data, int level = Level);
+
+    // True if an Accept-Encoding header allows gzip (explicitly or by "*")
+    static bool Accepted(const std::string& acceptEncoding);
+};
+
+// Incremental gzip for streamed responses. Each Write() flushes, so every
+// chunk sent can be decoded by the client as soon as it arrives.
+class GzipStream {
+public:
+    explicit GzipStream(int level = Gzip::Level);
+    ~GzipStream();
+    GzipStream(const GzipStream&) = delete;
+    GzipStream& operator=(const GzipStream&) = delete;
+
+    // Compresses `data` into `out` (replacing its contents); `finish` ends
+    // the stream. False on a zlib error.
+    bool Write(const std::string& data, bool finish, std::string& out);
+
+private:
+    std::unique_ptr<z_stream_s> m_zs;
+    bool m_ok = false;
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include "imgui.h"
+#include "GLHeaders.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Event density on a 1-degree lat/lon grid, weighted by count or by
+// radiated seismic energy. Bins follow the feed incrementally; blur and
+// colour mapping only run when a bin changed, and the result is a single
+// texture stretched over the map.
+class HeatmapLayer {
+public:
+    static constexpr int Cols = 360;
+    static constexpr int Rows = 180;
+
+    enum class Weight { Count, Energy };
+
+    void Clear() {
+        std::fill(m_count.begin(), m_count.end(), 0.0f);
+        std::fill(m_energy.begin(), m_energy.end(), 0.0);
+        m_entries.clear();
+        m_dirty = true;
+    }
+
+    void Add(const std::string& id, double lon, double lat, double mag) {
+        if (m_entries.count(id)) Remove(id);
+        Entry e{Bin(lon, lat), Energy(mag)};
+        m_count[e.bin] += 1.0f;
+        m_energy[e.bin] += e.energy;
+        m_entries[id] = e;
+        m_dirty = true;
+    }
+
+    void Remove(const std::string& id) {
+        auto it = m_entries.find(id);
+        if (it == m_entries.end()) return;
+        int bin = it->second.bin;
+        m_count[bin] -= 1.0f;
+        // Reset empty bins exactly so float drift never leaves a ghost
+        if (m_count[bin] <= 0.0f) { m_count[bin] = 0.0f; m_energy[bin] = 0.0; }
+        else m_energy[bin] = std::max(0.0, m_energy[bin] - it->second.energy);
+        m_entries.erase(it);
+        m_dirty = true;
+    }
+
+    void SetWeight(Weight w) {
+        if (w != m_weight) { m_weight = w; m_dirty = true; }
+    }
+
+    size_t Size() const { return m_entries.size(); }
+    int CountAt(double lon, double lat) const { return (int)m_count[Bin(lon, lat)]; }
+
+    // Blur, colour-map and upload if anything changed (render thread).
+    ImTextureID Texture() {
+        if (m_dirty) Rebuild();
+        return (ImTextureID)(intptr_t)m_texture;
+    }
+
+private:
+    struct Entry {
+        int bin;
+        double energy;
+    };
+
+    static int Bin(double lon, double lat) {
+        int x = std::clamp((int)((lon + 180.0) / 360.0 * Cols), 0, Cols - 1);
+        int y = std::clamp((int)((90.0 - lat) / 180.0 * Rows), 0, Rows - 1);
+        return y * Cols + x;
+    }
+
+    // Gutenberg-Richter energy in joules, log10 E = 1.5 M + 4.8
+    static double Energy(double mag) { return std::pow(10.0, 1.5 * mag + 4.8); }
+
+    void Rebuild() {
+        m_dirty = false;
+
+        // Energies span ~15 orders of magnitude, so blur them in log space
+        for (int i = 0; i < Cols * Rows; i++) {
+            m_src[i] = m_weight == Weight::Count ? m_count[i] : (m_energy[i] > 0.0 ? (float)std::log10(1.0 + m_energy[i]) : 0.0f);
+        }
+
+        // Separable 5-tap binomial blur. Both passes keep x in the inner loop
+        // over contiguous rows so the compiler vectorizes them; longitude wraps.
+        static const float k[5] = {1.0f / 16, 4.0f / 16, 6.0f / 16, 4.0f / 16, 1.0f / 16};
+        for (int y = 0; y < Rows; y++) {
+            const float* src = &m_src[(size_t)y * Cols];
+            float* dst = &m_tmp[(size_t)y * Cols];
+            for (int x = 0; x < 2; x++) {
+                float acc = 0.0f;
+                for (int t = -2; t <= 2; t++) acc += k[t + 2] * src[(x + t + Cols) % Cols];
+                dst[x] = acc;
+            }
+            for (int x = 2; x < Cols - 2; x++) {
+                dst[x] = k[0] * src[x - 2] + k[1] * src[x - 1] + k[2] * src[x] + k[3] * src[x + 1] + k[4] * src[x + 2];
+            }
+            for (int x = Cols - 2; x < Cols; x++) {
+                float acc = 0.0f;
+                for (int t = -2; t <= 2; t++) acc += k[t + 2] * src[(x + t) % Cols];
+                dst[x] = acc;
+            }
+        }
+        float maxV = 0.0f;
+        for (int y = 0; y < Rows; y++) {
+            float* dst = &m_src[(size_t)y * Cols];
+            std::fill(dst, dst + Cols, 0.0f);
+            for (int t = -2; t <= 2; t++) {
+                const float* row = &m_tmp[(size_t)std::clamp(y + t, 0, Rows - 1) * Cols];
+                const float w = k[t + 2];
+                for (int x = 0; x < Cols; x++) dst[x] += w * row[x];
+            }
+            for (int x = 0; x < Cols; x++) maxV = std::max(maxV, dst[x]);
+        }
+
+        // Colour ramp: transparent -> blue -> yellow -> red
+        float inv = maxV > 0.0f ? 1.0f / maxV : 0.0f;
+        for (int i = 0; i < Cols * Rows; i++) {
+            float v = std::sqrt(m_src[i] * inv);
+            unsigned char* px = &m_rgba[(size_t)i * 4];
+            float r, g, b;
+            if (v < 0.5f) { float t = v * 2.0f; r = t; g = t; b = 1.0f - t; }
+            else          { float t = (v - 0.5f) * 2.0f; r = 1.0f; g = 1.0f - t; b = 0.0f; }
+            px[0] = (unsigned char)(r * 255.0f);
+            px[1] = (unsigned char)(g * 255.0f);
+            px[2] = (unsigned char)(b * 255.0f);
+            px[3] = (unsigned char)(std::min(1.0f, v * 1.5f) * 210.0f);
+        }
+
+        if (!m_texture) {
+            glGenTextures(1, &m_texture);
+            glBindTexture(GL_TEXTURE_2D, m_texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Cols, Rows, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_rgba.data());
+        } else {
+            glBindTexture(GL_TEXTURE_2D, m_texture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Cols, Rows, GL_RGBA, GL_UNSIGNED_BYTE, m_rgba.data());
+        }
+    }
+
+    std::vector<float> m_count = std::vector<float>((size_t)Cols * Rows, 0.0f);
+    std::vector<double> m_energy = std::vector<double>((size_t)Cols * Rows, 0.0);
+    std::vector<float> m_src = std::vector<float>((size_t)Cols * Rows, 0.0f);
+    std::vector<float> m_tmp = std::vector<float>((size_t)Cols * Rows, 0.0f);
+    std::vector<unsigned char> m_rgba = std::vector<unsigned char>((size_t)Cols * Rows * 4, 0);
+    std::unordered_map<std::string, Entry> m_entries;
+    Weight m_weight = Weight::Count;
+    GLuint m_texture = 0;
+    bool m_dirty = true;
+};
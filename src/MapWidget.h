@@ -1,72 +1,341 @@
 #pragma once
 #include "imgui.h"
 #include "EarthquakeService.h"
+#include "BaseMap.h"
+#include "MarkerRenderer.h"
+#include "MarkerHitGrid.h"
+#include "ClusterPyramid.h"
+#include "HeatmapLayer.h"
 #include <vector>
 #include <string>
-#include <cmath> 
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 
 class MapWidget {
 public:
-    static void Draw(const std::vector<Earthquake>& quakes, ImTextureID textureID, const std::string& selectedID, const char* label = "MapRegion") {
-        if (ImGui::BeginChild(label, ImVec2(0, 300), true, ImGuiWindowFlags_NoScrollbar)) {
-            
+    static constexpr float MaxZoom = 64.0f;
+    static constexpr float ClusterCellPx = 48.0f;   // target on-screen size of a cluster cell
+    static constexpr size_t HeatmapThreshold = 20000; // Auto layer switches to the heatmap above this
+
+    enum class Layer { Auto, Markers, Heatmap };
+
+    // Hand over a new marker set; `generation` changes whenever `quakes` does.
+    void Update(const std::vector<Earthquake>& quakes, uint64_t generation) {
+        m_markers.Update(quakes, generation);
+        m_generation = generation;
+        m_indexById.clear();
+        for (int i = 0; i < (int)quakes.size(); i++) m_indexById[quakes[i].id] = i;
+    }
+
+    // Cluster pyramid and heatmap maintenance: full rebuild after a filter
+    // change, incremental when only the feed changed.
+    void RebuildLayers(const std::vector<Earthquake>& quakes) {
+        m_pyramid.Clear();
+        m_heatmap.Clear();
+        for (const auto& q : quakes) AddToLayers(q);
+    }
+
+    template <typename Pred>
+    void ApplyChanges(const QuakeChangeSet& changes, Pred passes) {
+        for (const auto& id : changes.removed) RemoveFromLayers(id);
+        for (const auto& q : changes.updated) {
+            if (passes(q)) AddToLayers(q);
+            else RemoveFromLayers(q.id);
+        }
+        for (const auto& q : changes.inserted) {
+            if (passes(q)) AddToLayers(q);
+        }
+    }
+
+    // True while something on the map animates (the selected-marker pulse).
+    bool IsAnimating() const { return m_animating; }
+
+    void SetClustering(bool enable) { m_clustering = enable; }
+    void SetLayer(Layer layer) { m_layer = layer; }
+    void SetHeatmapWeight(HeatmapLayer::Weight w) { m_heatmap.SetWeight(w); }
+
+    // Returns true when a marker was clicked (selectedID is updated).
+    bool Draw(const std::vector<Earthquake>& quakes, const BaseMap& baseMap, std::string& selectedID, const char* label = "MapRegion") {
+        bool clicked = false;
+        if (ImGui::BeginChild(label, ImVec2(0, 300), true, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse)) {
+
             ImDrawList* draw_list = ImGui::GetWindowDrawList();
             ImVec2 p = ImGui::GetCursorScreenPos();
             ImVec2 size = ImGui::GetWindowSize();
 
-            // 1. Draw Map Image
-            if (textureID) {
-                draw_list->AddImage(textureID, p, ImVec2(p.x + size.x, p.y + size.y));
+            // 0. Zoom (wheel, around the cursor) and pan (drag); double-click resets
+            ImGui::InvisibleButton("##MapInput", size);
+            bool hovered = ImGui::IsItemHovered();
+            ImVec2 mouse = ImGui::GetMousePos();
+            HandleInput(hovered, mouse, p, size);
+
+            // Screen rect of the whole world at the current zoom/pan
+            ImVec2 wMin(p.x + (0.5f - m_centerX * m_zoom) * size.x, p.y + (0.5f - m_centerY * m_zoom) * size.y);
+            ImVec2 wSize(size.x * m_zoom, size.y * m_zoom);
+
+            // 1. Draw Map Tiles (placeholder until the async load finishes)
+            if (baseMap.IsReady()) {
+                for (const auto& t : baseMap.Tiles()) {
+                    draw_list->AddImage(t.texture, ImVec2(wMin.x + t.min.x * wSize.x, wMin.y + t.min.y * wSize.y),
+                                        ImVec2(wMin.x + t.max.x * wSize.x, wMin.y + t.max.y * wSize.y));
+                }
             } else {
+                char text[64] = "Loading map...";
+                if (baseMap.HasFailed()) snprintf(text, sizeof(text), "Map unavailable, retrying in %ds", baseMap.RetryInSeconds());
                 draw_list->AddRectFilled(p, ImVec2(p.x + size.x, p.y + size.y), IM_COL32(20, 30, 45, 255));
+                draw_list->AddText(ImVec2(p.x + 10, p.y + 10), IM_COL32(150, 170, 190, 255), text);
+            }
+
+            // 2. Draw Earthquakes: density heatmap, visible clusters, or every
+            //    marker in one instanced draw
+            bool viewChanged = wMin.x != m_gridOrigin.x || wMin.y != m_gridOrigin.y || wSize.x != m_gridSize.x || wSize.y != m_gridSize.y;
+            bool heatmap = m_layer == Layer::Heatmap || (m_layer == Layer::Auto && m_heatmap.Size() > HeatmapThreshold);
+            if (heatmap) {
+                draw_list->AddImage(m_heatmap.Texture(), wMin, ImVec2(wMin.x + wSize.x, wMin.y + wSize.y));
+                if (m_gridMode != 2) {
+                    m_hits.Build({}, p, size);
+                    m_gridMode = 2;
+                }
+            } else if (m_clustering) {
+                if (viewChanged || m_gridMode != 1 || m_gridRevision != m_pyramid.Revision()) {
+                    BuildClusters(p, size, wMin, wSize);
+                    m_gridMode = 1;
+                    m_gridRevision = m_pyramid.Revision();
+                }
+                DrawClusters(draw_list);
+            } else {
+                if (viewChanged || m_gridMode != 0 || m_gridGeneration != m_generation) {
+                    // 3. Hit-testing grid, rebuilt only when markers or the view change
+                    std::vector<MarkerHitGrid::Point> points;
+                    points.reserve(quakes.size());
+                    for (int i = 0; i < (int)quakes.size(); i++) {
+                        points.push_back({Project(quakes[i], wMin, wSize), Radius(quakes[i].mag), i});
+                    }
+                    m_hits.Build(points, p, size);
+                    m_gridMode = 0;
+                    m_gridGeneration = m_generation;
+                }
+                if (m_markers.IsAvailable()) {
+                    m_markers.Queue(draw_list, wMin, wSize);
+                } else {
+                    for (const auto& q : quakes) {
+                        draw_list->AddCircleFilled(Project(q, wMin, wSize), Radius(q.mag), Color(q.mag));
+                    }
+                }
+            }
+            m_gridOrigin = wMin;
+            m_gridSize = wSize;
+
+            // --- HIGHLIGHT LOGIC ---
+            int selectedIndex = -1;
+            if (!selectedID.empty()) {
+                auto it = m_indexById.find(selectedID);
+                if (it != m_indexById.end() && it->second < (int)quakes.size()) selectedIndex = it->second;
+            }
+            m_animating = selectedIndex >= 0;
+            if (selectedIndex >= 0) {
+                const auto& q = quakes[selectedIndex];
+                ImVec2 center = Project(q, wMin, wSize);
+                float radius = Radius(q.mag);
+
+                // Animation: Pulsing Ring
+                float time = (float)ImGui::GetTime();
+                float pulse = (sin(time * 10.0f) + 1.0f) * 0.5f;
+                float ringRadius = radius + 5.0f + (pulse * 10.0f);
+
+                // Draw Cyan Ring
+                draw_list->AddCircle(center, ringRadius, IM_COL32(0, 255, 255, 255), 0, 2.0f);
+
+                // Draw Crosshair
+                draw_list->AddLine(ImVec2(center.x - 20, center.y), ImVec2(center.x + 20, center.y), IM_COL32(0, 255, 255, 200));
+                draw_list->AddLine(ImVec2(center.x, center.y - 20), ImVec2(center.x, center.y + 20), IM_COL32(0, 255, 255, 200));
+
+                // Use a label near the dot instead of a tooltip
+                draw_list->AddText(ImVec2(center.x + 10, center.y - 10), IM_COL32(255, 255, 255, 255), q.place.c_str());
             }
 
-            // 2. Draw Earthquakes
-            for (const auto& q : quakes) {
-                float x = p.x + ((float)((q.lon + 180.0) / 360.0) * size.x);
-                float y = p.y + ((float)((90.0 - q.lat) / 180.0) * size.y);
-                ImVec2 center(x, y);
-
-                bool isSelected = (q.id == selectedID);
-
-                // Standard Color
-                ImU32 color;
-                if (q.mag < 4.5)      color = IM_COL32(100, 255, 100, 200);
-                else if (q.mag < 6.0) color = IM_COL32(255, 255, 0, 200);
-                else                  color = IM_COL32(255, 50, 50, 240);
-
-                // Draw Base Dot
-                float radius = (float)(q.mag * 1.5f) + 2.0f;
-                draw_list->AddCircleFilled(center, radius, color);
-
-                // --- HIGHLIGHT LOGIC ---
-                if (isSelected) {
-                    // Animation: Pulsing Ring
-                    float time = (float)ImGui::GetTime();
-                    float pulse = (sin(time * 10.0f) + 1.0f) * 0.5f; 
-                    float ringRadius = radius + 5.0f + (pulse * 10.0f); 
-                    
-                    // Draw Cyan Ring
-                    draw_list->AddCircle(center, ringRadius, IM_COL32(0, 255, 255, 255), 0, 2.0f);
-                    
-                    // Draw Crosshair
-                    draw_list->AddLine(ImVec2(center.x - 20, center.y), ImVec2(center.x + 20, center.y), IM_COL32(0, 255, 255, 200));
-                    draw_list->AddLine(ImVec2(center.x, center.y - 20), ImVec2(center.x, center.y + 20), IM_COL32(0, 255, 255, 200));
-                    
-                    // FIX: REMOVED "SetTooltip" FROM HERE
-                    // Use a label near the dot instead if you want text
-                    draw_list->AddText(ImVec2(center.x + 10, center.y - 10), IM_COL32(255, 255, 255, 255), q.place.c_str());
+            // Hover Tooltip + click for the single nearest marker or cluster
+            if (hovered && !ImGui::IsMouseDragging(ImGuiMouseButton_Left)) {
+                int hit = m_hits.Pick(mouse);
+                int quakeIndex = -1;
+                const Cluster* cluster = nullptr;
+                if (hit >= 0 && m_clustering) {
+                    cluster = &m_clusters[hit];
+                    if (cluster->count == 1) {
+                        auto it = m_indexById.find(cluster->singleId);
+                        if (it != m_indexById.end()) quakeIndex = it->second;
+                    }
+                } else if (hit >= 0) {
+                    quakeIndex = hit;
+                }
+
+                if (heatmap) {
+                    double lon = (mouse.x - wMin.x) / wSize.x * 360.0 - 180.0;
+                    double lat = 90.0 - (mouse.y - wMin.y) / wSize.y * 180.0;
+                    ImGui::SetTooltip("%d events in this 1-degree cell", m_heatmap.CountAt(lon, lat));
                 }
 
-                // Hover Tooltip (Only when mouse is actually over the dot)
-                if (ImGui::IsMouseHoveringRect(ImVec2(center.x - 5, center.y - 5), ImVec2(center.x + 5, center.y + 5))) {
+                if (quakeIndex >= 0) {
+                    const auto& q = quakes[quakeIndex];
                     ImGui::BeginTooltip();
                     ImGui::Text("%s", q.place.c_str());
                     ImGui::Text("Mag: %.1f", q.mag);
                     ImGui::EndTooltip();
+
+                    if (m_clickReleased) {
+                        selectedID = q.id;
+                        clicked = true;
+                    }
+                } else if (cluster) {
+                    ImGui::BeginTooltip();
+                    ImGui::Text("%d events", cluster->count);
+                    ImGui::Text("Max Mag: %.1f", cluster->maxMag);
+                    ImGui::TextDisabled("Click to zoom in");
+                    ImGui::EndTooltip();
+
+                    if (m_clickReleased) ZoomAt(cluster->pos, p, size, m_zoom * 2.0f, true);
                 }
             }
         }
         ImGui::EndChild();
+        return clicked;
     }
-};
\ No newline at end of file
+
+private:
+    struct Cluster {
+        ImVec2 pos;
+        int count;
+        double maxMag;
+        std::string singleId;   // set when count == 1
+    };
+
+    void HandleInput(bool hovered, const ImVec2& mouse, const ImVec2& p, const ImVec2& size) {
+        ImGuiIO& io = ImGui::GetIO();
+        m_clickReleased = false;
+
+        if (hovered && io.MouseWheel != 0.0f) {
+            ZoomAt(mouse, p, size, m_zoom * std::pow(1.25f, io.MouseWheel), false);
+        }
+        if (ImGui::IsItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left)) {
+            m_centerX -= io.MouseDelta.x / (size.x * m_zoom);
+            m_centerY -= io.MouseDelta.y / (size.y * m_zoom);
+            m_dragged = true;
+            ClampView();
+        }
+        if (ImGui::IsItemDeactivated()) {
+            m_clickReleased = hovered && !m_dragged;
+            m_dragged = false;
+        }
+        if (hovered && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+            m_zoom = 1.0f;
+            m_centerX = m_centerY = 0.5f;
+            m_clickReleased = false;
+        }
+    }
+
+    // Zoom so the world point under `anchor` stays put (or moves to the center).
+    void ZoomAt(const ImVec2& anchor, const ImVec2& p, const ImVec2& size, float newZoom, bool center) {
+        newZoom = std::clamp(newZoom, 1.0f, MaxZoom);
+        float ax = (anchor.x - p.x) / size.x - 0.5f, ay = (anchor.y - p.y) / size.y - 0.5f;
+        float wx = m_centerX + ax / m_zoom, wy = m_centerY + ay / m_zoom;
+        m_zoom = newZoom;
+        m_centerX = center ? wx : wx - ax / m_zoom;
+        m_centerY = center ? wy : wy - ay / m_zoom;
+        ClampView();
+    }
+
+    void ClampView() {
+        float half = 0.5f / m_zoom;
+        m_centerX = std::clamp(m_centerX, half, 1.0f - half);
+        m_centerY = std::clamp(m_centerY, half, 1.0f - half);
+    }
+
+    // Collect the non-empty pyramid cells inside the view at the level whose
+    // cells are about ClusterCellPx wide; cost follows the visible cells only.
+    void BuildClusters(const ImVec2& p, const ImVec2& size, const ImVec2& wMin, const ImVec2& wSize) {
+        int level = 0;
+        while (level + 1 < ClusterPyramid::Levels && wSize.x / ClusterPyramid::Cols(level + 1) >= ClusterCellPx) level++;
+
+        float cellW = wSize.x / ClusterPyramid::Cols(level), cellH = wSize.y / ClusterPyramid::Rows(level);
+        int x0 = (int)std::floor((p.x - wMin.x) / cellW) - 1, x1 = (int)std::floor((p.x + size.x - wMin.x) / cellW) + 1;
+        int y0 = (int)std::floor((p.y - wMin.y) / cellH) - 1, y1 = (int)std::floor((p.y + size.y - wMin.y) / cellH) + 1;
+
+        m_clusters.clear();
+        m_pyramid.ForEachCell(level, x0, y0, x1, y1, [&](int cx, int cy, const ClusterPyramid::Cell& c) {
+            Cluster cl;
+            cl.pos = ImVec2(wMin.x + (float)((c.lon() + 180.0) / 360.0) * wSize.x, wMin.y + (float)((90.0 - c.lat()) / 180.0) * wSize.y);
+            cl.count = c.count;
+            cl.maxMag = c.maxMag;
+            if (c.count == 1) cl.singleId = m_pyramid.SingleMember(level, cx, cy);
+            m_clusters.push_back(std::move(cl));
+        });
+
+        std::vector<MarkerHitGrid::Point> points;
+        points.reserve(m_clusters.size());
+        for (int i = 0; i < (int)m_clusters.size(); i++) {
+            points.push_back({m_clusters[i].pos, ClusterRadius(m_clusters[i]), i});
+        }
+        m_hits.Build(points, p, size);
+    }
+
+    void DrawClusters(ImDrawList* draw_list) const {
+        char text[16];
+        for (const auto& cl : m_clusters) {
+            float r = ClusterRadius(cl);
+            draw_list->AddCircleFilled(cl.pos, r, Color(cl.maxMag));
+            if (cl.count == 1) continue;
+            draw_list->AddCircle(cl.pos, r, IM_COL32(20, 20, 20, 220), 0, 1.5f);
+            snprintf(text, sizeof(text), "%d", cl.count);
+            ImVec2 ts = ImGui::CalcTextSize(text);
+            draw_list->AddText(ImVec2(cl.pos.x - ts.x * 0.5f, cl.pos.y - ts.y * 0.5f), IM_COL32(0, 0, 0, 255), text);
+        }
+    }
+
+    void AddToLayers(const Earthquake& q) {
+        m_pyramid.Insert(q.id, q.lon, q.lat, q.mag);
+        m_heatmap.Add(q.id, q.lon, q.lat, q.mag);
+    }
+
+    void RemoveFromLayers(const std::string& id) {
+        m_pyramid.Remove(id);
+        m_heatmap.Remove(id);
+    }
+
+    static float ClusterRadius(const Cluster& cl) {
+        return cl.count == 1 ? Radius(cl.maxMag) : 9.0f + 3.0f * std::log2((float)cl.count);
+    }
+
+    static ImVec2 Project(const Earthquake& q, const ImVec2& wMin, const ImVec2& wSize) {
+        return ImVec2(wMin.x + ((float)((q.lon + 180.0) / 360.0) * wSize.x),
+                      wMin.y + ((float)((90.0 - q.lat) / 180.0) * wSize.y));
+    }
+
+    static float Radius(double mag) { return (float)(mag * 1.5f) + 2.0f; }
+
+    // Standard Color
+    static ImU32 Color(double mag) {
+        if (mag < 4.5)      return IM_COL32(100, 255, 100, 200);
+        else if (mag < 6.0) return IM_COL32(255, 255, 0, 200);
+        else                return IM_COL32(255, 50, 50, 240);
+    }
+
+    MarkerRenderer m_markers;
+    MarkerHitGrid m_hits;
+    ClusterPyramid m_pyramid;
+    HeatmapLayer m_heatmap;
+    Layer m_layer = Layer::Auto;
+    std::vector<Cluster> m_clusters;
+    std::unordered_map<std::string, int> m_indexById;
+    bool m_clustering = true;
+
+    // View state: zoom factor and normalized world point at the map center
+    float m_zoom = 1.0f, m_centerX = 0.5f, m_centerY = 0.5f;
+    bool m_dragged = false, m_clickReleased = false, m_animating = false;
+
+    // What the hit grid was last built for (0 = all markers, 1 = clusters, 2 = heatmap)
+    int m_gridMode = -1;
+    uint64_t m_generation = 0, m_gridGeneration = UINT64_MAX, m_gridRevision = UINT64_MAX;
+    ImVec2 m_gridOrigin, m_gridSize;
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include "imgui.h"
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// Screen-space bucket grid of projected markers. Built once per marker set
+// and map rect (counting sort into per-cell ranges), after which "nearest
+// marker under the cursor" only inspects the 3x3 cells around the mouse.
+class MarkerHitGrid {
+public:
+    static constexpr float CellSize = 16.0f;
+
+    struct Point {
+        ImVec2 pos;
+        float radius;
+        int index;   // index into the marker array the grid was built from
+    };
+
+    void Build(const std::vector<Point>& points, const ImVec2& origin, const ImVec2& size) {
+        m_origin = origin;
+        m_cols = std::max(1, (int)(size.x / CellSize) + 1);
+        m_rows = std::max(1, (int)(size.y / CellSize) + 1);
+
+        m_cellStart.assign((size_t)m_cols * m_rows + 1, 0);
+        for (const auto& pt : points) m_cellStart[CellOf(pt.pos) + 1]++;
+        for (size_t i = 1; i < m_cellStart.size(); i++) m_cellStart[i] += m_cellStart[i - 1];
+
+        m_points.resize(points.size());
+        std::vector<int> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+        for (const auto& pt : points) m_points[fill[CellOf(pt.pos)]++] = pt;
+    }
+
+    // Index of the closest marker whose pick radius covers `mouse`, or -1.
+    int Pick(const ImVec2& mouse, float minRadius = 6.0f) const {
+        if (m_points.empty()) return -1;
+        int cx = (int)((mouse.x - m_origin.x) / CellSize);
+        int cy = (int)((mouse.y - m_origin.y) / CellSize);
+
+        int best = -1;
+        float bestDist = 0.0f;
+        for (int y = cy - 1; y <= cy + 1; y++) {
+            if (y < 0 || y >= m_rows) continue;
+            for (int x = cx - 1; x <= cx + 1; x++) {
+                if (x < 0 || x >= m_cols) continue;
+                int cell = y * m_cols + x;
+                for (int i = m_cellStart[cell]; i < m_cellStart[cell + 1]; i++) {
+                    const Point& pt = m_points[i];
+                    float dx = pt.pos.x - mouse.x, dy = pt.pos.y - mouse.y;
+                    float d2 = dx * dx + dy * dy;
+                    float r = std::min(CellSize, std::max(minRadius, pt.radius));
+                    if (d2 <= r * r && (best < 0 || d2 < bestDist)) { best = pt.index; bestDist = d2; }
+                }
+            }
+        }
+        return best;
+    }
+
+private:
+    int CellOf(const ImVec2& pos) const {
+        int x = std::clamp((int)((pos.x - m_origin.x) / CellSize), 0, m_cols - 1);
+        int y = std::clamp((int)((pos.y - m_origin.y) / CellSize), 0, m_rows - 1);
+        return y * m_cols + x;
+    }
+
+    ImVec2 m_origin;
+    int m_cols = 0, m_rows = 0;
+    std::vector<int> m_cellStart;
+    std::vector<Point> m_points;
+};
@@ -0,0 +1,159 @@
+#pragma once
+#include "imgui.h"
+#include "GLHeaders.h"
+#include "EarthquakeService.h"
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+// Draws every quake marker with one instanced draw call from inside the
+// ImGui draw list. Per-quake attributes live in a GPU buffer that is only
+// re-uploaded when the marker set changes; the shader expands each
+// instance into a quad and shades an anti-aliased circle (SDF).
+class MarkerRenderer {
+public:
+    // Upload the instance buffer if `generation` differs from the last upload.
+    void Update(const std::vector<Earthquake>& quakes, uint64_t generation) {
+        if (!EnsureInit() || generation == m_generation) return;
+        m_generation = generation;
+
+        m_instances.clear();
+        m_instances.reserve(quakes.size() * 4);
+        for (const auto& q : quakes) {
+            m_instances.push_back((float)q.lon);
+            m_instances.push_back((float)q.lat);
+            m_instances.push_back((float)q.mag);
+            m_instances.push_back(q.mag < 4.5 ? 0.0f : (q.mag < 6.0 ? 1.0f : 2.0f));
+        }
+        m_count = (GLsizei)quakes.size();
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(m_instances.size() * sizeof(float)), m_instances.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // False if the GL path is unavailable (shader failed); callers fall back to the draw list.
+    bool IsAvailable() const { return m_program != 0; }
+
+    // Queue the instanced draw at the current position in the draw list.
+    // mapMin/mapSize is the screen rect of the whole (possibly zoomed) world.
+    void Queue(ImDrawList* draw_list, const ImVec2& mapMin, const ImVec2& mapSize) {
+        if (!m_program || m_count == 0) return;
+        m_mapMin = mapMin;
+        m_mapSize = mapSize;
+        draw_list->AddCallback(&MarkerRenderer::RenderCallback, this);
+        draw_list->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+    }
+
+private:
+    static void RenderCallback(const ImDrawList*, const ImDrawCmd* cmd) {
+        static_cast<MarkerRenderer*>(cmd->UserCallbackData)->Render(cmd->ClipRect);
+    }
+
+    void Render(const ImVec4& clip) {
+        ImDrawData* dd = ImGui::GetDrawData();
+
+        // Zoomed markers extend past the map, so clip to the owning window
+        float sx = dd->FramebufferScale.x, sy = dd->FramebufferScale.y;
+        float fbHeight = dd->DisplaySize.y * sy;
+        glScissor((GLint)((clip.x - dd->DisplayPos.x) * sx), (GLint)(fbHeight - (clip.w - dd->DisplayPos.y) * sy),
+                  (GLsizei)((clip.z - clip.x) * sx), (GLsizei)((clip.w - clip.y) * sy));
+
+        glUseProgram(m_program);
+        glUniform4f(m_uMapRect, m_mapMin.x, m_mapMin.y, m_mapSize.x, m_mapSize.y);
+        glUniform4f(m_uDisplay, dd->DisplayPos.x, dd->DisplayPos.y, dd->DisplaySize.x, dd->DisplaySize.y);
+        glBindVertexArray(m_vao);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, m_count);
+        glBindVertexArray(0);
+    }
+
+    bool EnsureInit() {
+        if (m_initialized) return m_program != 0;
+        m_initialized = true;
+
+        static const char* vs =
+            "#version 150\n"
+            "in vec4 aInstance;\n"          // lon, lat, mag, color class
+            "uniform vec4 uMapRect;\n"      // screen x, y, w, h
+            "uniform vec4 uDisplay;\n"      // display pos, size
+            "out vec2 vLocal;\n"
+            "out float vRadius;\n"
+            "out vec4 vColor;\n"
+            "void main() {\n"
+            "    vec2 corner = vec2((gl_VertexID & 1) == 0 ? -1.0 : 1.0, (gl_VertexID & 2) == 0 ? -1.0 : 1.0);\n"
+            "    vRadius = aInstance.z * 1.5 + 2.0;\n"
+            "    vLocal = corner * (vRadius + 1.0);\n"
+            "    vec2 center = uMapRect.xy + vec2((aInstance.x + 180.0) / 360.0, (90.0 - aInstance.y) / 180.0) * uMapRect.zw;\n"
+            "    vec2 ndc = (center + vLocal - uDisplay.xy) / uDisplay.zw * 2.0 - 1.0;\n"
+            "    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);\n"
+            "    if (aInstance.w < 0.5)      vColor = vec4(100.0, 255.0, 100.0, 200.0) / 255.0;\n"
+            "    else if (aInstance.w < 1.5) vColor = vec4(255.0, 255.0, 0.0, 200.0) / 255.0;\n"
+            "    else                        vColor = vec4(255.0, 50.0, 50.0, 240.0) / 255.0;\n"
+            "}\n";
+        static const char* fs =
+            "#version 150\n"
+            "in vec2 vLocal;\n"
+            "in float vRadius;\n"
+            "in vec4 vColor;\n"
+            "out vec4 outColor;\n"
+            "void main() {\n"
+            "    float coverage = clamp(vRadius - length(vLocal) + 0.5, 0.0, 1.0);\n"
+            "    if (coverage <= 0.0) discard;\n"
+            "    outColor = vec4(vColor.rgb, vColor.a * coverage);\n"
+            "}\n";
+
+        GLuint v = Compile(GL_VERTEX_SHADER, vs), f = Compile(GL_FRAGMENT_SHADER, fs);
+        if (v && f) {
+            GLuint prog = glCreateProgram();
+            glAttachShader(prog, v);
+            glAttachShader(prog, f);
+            glBindAttribLocation(prog, 0, "aInstance");
+            glLinkProgram(prog);
+            GLint ok = 0;
+            glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+            if (ok) m_program = prog;
+            else { std::cerr << "Marker shader link failed" << std::endl; glDeleteProgram(prog); }
+        }
+        if (v) glDeleteShader(v);
+        if (f) glDeleteShader(f);
+        if (!m_program) return false;
+
+        m_uMapRect = glGetUniformLocation(m_program, "uMapRect");
+        m_uDisplay = glGetUniformLocation(m_program, "uDisplay");
+
+        glGenVertexArrays(1, &m_vao);
+        glGenBuffers(1, &m_vbo);
+        glBindVertexArray(m_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+        glVertexAttribDivisor(0, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return true;
+    }
+
+    static GLuint Compile(GLenum type, const char* src) {
+        GLuint s = glCreateShader(type);
+        glShaderSource(s, 1, &src, nullptr);
+        glCompileShader(s);
+        GLint ok = 0;
+        glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+        if (!ok) {
+            char log[512];
+            glGetShaderInfoLog(s, sizeof(log), nullptr, log);
+            std::cerr << "Marker shader compile failed: " << log << std::endl;
+            glDeleteShader(s);
+            return 0;
+        }
+        return s;
+    }
+
+    bool m_initialized = false;
+    GLuint m_program = 0, m_vao = 0, m_vbo = 0;
+    GLint m_uMapRect = -1, m_uDisplay = -1;
+    GLsizei m_count = 0;
+    uint64_t m_generation = UINT64_MAX;
+    std::vector<float> m_instances;
+    ImVec2 m_mapMin, m_mapSize;
+};
@@ -0,0 +1,170 @@
+#include "Metrics.h"
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+const double Metrics::Buckets[Metrics::BucketCount] = {
+    0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01,
+    0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 10.0,
+};
+
+namespace {
+
+// One thread's share of every counter and histogram. Only the owning
+// thread writes; values are atomics so Expose() never reads a torn one.
+struct Shard {
+    std::atomic<double> counters[Metrics::MaxCounters] = {};
+    std::atomic<uint64_t> buckets[Metrics::MaxHistograms][Metrics::BucketCount + 1] = {};
+    std::atomic<double> sums[Metrics::MaxHistograms] = {};
+};
+
+enum class Kind { Counter, Gauge, Histogram };
+
+struct Series {
+    std::string name, help, labels;
+    Kind kind;
+    int slot;
+};
+
+std::mutex g_mutex;
+std::vector<std::shared_ptr<Shard>> g_shards;       // kept after their thread exits
+std::vector<Series> g_series;                       // in registration order
+std::map<std::string, int> g_index;                 // name{labels} -> g_series index
+int g_used[3] = {0, 0, 0};
+std::atomic<double> g_gauges[Metrics::MaxGauges] = {};
+
+Shard& LocalShard() {
+    thread_local std::shared_ptr<Shard> shard = [] {
+        auto s = std::make_shared<Shard>();
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_shards.push_back(s);
+        return s;
+    }();
+    return *shard;
+}
+
+// Single writer per shard, so a relaxed load + store is a race-free add
+template <typename T>
+void Bump(std::atomic<T>& v, T n) {
+    v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+int Register(const std::string& name, const std::string& help, const std::string& labels, Kind kind, int capacity) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    std::string key = name + "{" + labels + "}";
+    auto it = g_index.find(key);
+    if (it != g_index.end()) return g_series[(size_t)it->second].kind == kind ? g_series[(size_t)it->second].slot : -1;
+    int& used = g_used[(int)kind];
+    if (used >= capacity) return -1;
+    g_index[key] = (int)g_series.size();
+    g_series.push_back({name, help, labels, kind, used});
+    return used++;
+}
+
+void AppendSample(std::string& out, const std::string& name, const std::string& labels, const std::string& extra, double value) {
+    out += name;
+    if (!labels.empty() || !extra.empty()) {
+        out += '{';
+        out += labels;
+        if (!labels.empty() && !extra.empty()) out += ',';
+        out += extra;
+        out += '}';
+    }
+    char buf[40];
+    std::snprintf(buf, sizeof(buf), " %.10g\n", value);
+    out += buf;
+}
+
+} // namespace
+
+void Metrics::Counter::Add(double n) const {
+    if (m_slot >= 0) Bump(LocalShard().counters[m_slot], n);
+}
+
+void Metrics::Histogram::Observe(double seconds) const {
+    if (m_slot < 0) return;
+    int bucket = 0;
+    while (bucket < BucketCount && seconds > Buckets[bucket]) bucket++;
+    Shard& s = LocalShard();
+    Bump(s.buckets[m_slot][bucket], (uint64_t)1);
+    Bump(s.sums[m_slot], seconds);
+}
+
+void Metrics::Gauge::Set(double value) const {
+    if (m_slot >= 0) g_gauges[m_slot].store(value, std::memory_order_relaxed);
+}
+
+Metrics::Counter Metrics::GetCounter(const std::string& name, const std::string& help, const std::string& labels) {
+    Counter c;
+    c.m_slot = Register(name, help, labels, Kind::Counter, MaxCounters);
+    return c;
+}
+
+Metrics::Histogram Metrics::GetHistogram(const std::string& name, const std::string& help, const std::string& labels) {
+    Histogram h;
+    h.m_slot = Register(name, help, labels, Kind::Histogram, MaxHistograms);
+    return h;
+}
+
+Metrics::Gauge Metrics::GetGauge(const std::string& name, const std::string& help, const std::string& labels) {
+    Gauge g;
+    g.m_slot = Register(name, help, labels, Kind::Gauge, MaxGauges);
+    return g;
+}
+
+std::string Metrics::Expose() {
+    std::vector<std::shared_ptr<Shard>> shards;
+    std::vector<Series> series;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        shards = g_shards;
+        series = g_series;
+    }
+
+    // Samples of one metric name must be contiguous, after a single HELP/TYPE
+    std::map<std::string, std::vector<const Series*>> byName;
+    std::vector<std::string> order;
+    for (const auto& s : series) {
+        auto& list = byName[s.name];
+        if (list.empty()) order.push_back(s.name);
+        list.push_back(&s);
+    }
+
+    static const char* typeNames[] = {"counter", "gauge", "histogram"};
+    std::string out;
+    for (const auto& name : order) {
+        const auto& list = byName[name];
+        out += "# HELP " + name + " " + list.front()->help + "\n";
+        out += "# TYPE " + name + " " + typeNames[(int)list.front()->kind] + "\n";
+        for (const Series* s : list) {
+            if (s->kind == Kind::Counter) {
+                double total = 0;
+                for (const auto& shard : shards) total += shard->counters[s->slot].load(std::memory_order_relaxed);
+                AppendSample(out, name, s->labels, "", total);
+            } else if (s->kind == Kind::Gauge) {
+                AppendSample(out, name, s->labels, "", g_gauges[s->slot].load(std::memory_order_relaxed));
+            } else {
+                uint64_t counts[BucketCount + 1] = {};
+                double sum = 0;
+                for (const auto& shard : shards) {
+                    for (int b = 0; b <= BucketCount; b++) counts[b] += shard->buckets[s->slot][b].load(std::memory_order_relaxed);
+                    sum += shard->sums[s->slot].load(std::memory_order_relaxed);
+                }
+                uint64_t cumulative = 0;
+                char le[32];
+                for (int b = 0; b <= BucketCount; b++) {
+                    cumulative += counts[b];
+                    if (b < BucketCount) std::snprintf(le, sizeof(le), "le=\"%g\"", Buckets[b]);
+                    else std::snprintf(le, sizeof(le), "le=\"+Inf\"");
+                    AppendSample(out, name + "_bucket", s->labels, le, (double)cumulative);
+                }
+                AppendSample(out, name + "_sum", s->labels, "", sum);
+                AppendSample(out, name + "_count", s->labels, "", (double)cumulative);
+            }
+        }
+    }
+    return out;
+}
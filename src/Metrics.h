@@ -0,0 +1,72 @@
+#pragma once
+#include <chrono>
+#include <string>
+
+// Prometheus-style counters, gauges and histograms, exported as text by
+// GET /metrics. Counters and histograms are sharded per thread like the
+// Trace buffers: a thread only ever writes its own shard (plain relaxed
+// load + store, no locked instruction, no shared cache line), and Expose()
+// sums the shards. Handles are cheap values; look one up once, e.g. into a
+// function-local static, and record through it on the hot path.
+class Metrics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int MaxCounters = 128;
+    static constexpr int MaxHistograms = 64;
+    static constexpr int MaxGauges = 32;
+    static constexpr int BucketCount = 16;   // plus +Inf
+
+    // Upper bounds (seconds) shared by every histogram: 50 us .. 10 s
+    static const double Buckets[BucketCount];
+
+    class Counter {
+    public:
+        void Add(double n = 1) const;
+    private:
+        friend class Metrics;
+        int m_slot = -1;
+    };
+
+    class Histogram {
+    public:
+        void Observe(double seconds) const;
+        void ObserveSince(Clock::time_point start) const {
+            Observe(std::chrono::duration<double>(Clock::now() - start).count());
+        }
+    private:
+        friend class Metrics;
+        int m_slot = -1;
+    };
+
+    class Gauge {
+    public:
+        void Set(double value) const;
+    private:
+        friend class Metrics;
+        int m_slot = -1;
+    };
+
+    // Observes the scope's duration into a histogram
+    class Timer {
+    public:
+        explicit Timer(const Histogram& h) : m_histogram(h), m_start(Clock::now()) {}
+        ~Timer() { m_histogram.ObserveSince(m_start); }
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+    private:
+        const Histogram& m_histogram;
+        Clock::time_point m_start;
+    };
+
+    // Series are identified by name plus label set (`labels` is the text
+    // inside the braces, e.g. route="/status"). Asking again for the same
+    // series returns the same handle. Takes a lock: not for the hot path.
+    // Once a kind's slots run out, further handles record nothing.
+    static Counter GetCounter(const std::string& name, const std::string& help, const std::string& labels = "");
+    static Histogram GetHistogram(const std::string& name, const std::string& help, const std::string& labels = "");
+    static Gauge GetGauge(const std::string& name, const std::string& help, const std::string& labels = "");
+
+    // Prometheus text exposition format 0.0.4
+    static std::string Expose();
+};
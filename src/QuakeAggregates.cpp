@@ -0,0 +1,123 @@
+#include "QuakeAggregates.h"
+#include "EarthquakeService.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+long long FloorDiv(long long a, long long b) {
+    long long q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+} // namespace
+
+int QuakeAggregates::MagBin(double mag) {
+    double tenths = std::floor(mag * 10.0 + 1e-9);
+    if (!(tenths >= MagTenthsMin)) return 0;   // also NaN
+    return (int)std::min<double>(tenths - MagTenthsMin, MagBins - 1);
+}
+
+std::vector<QuakeAggregates::Bin> QuakeAggregates::Histogram(int widthTenths) const {
+    std::vector<Bin> bins;
+    long long first = 0;
+    for (int i = 0; i < MagBins; i++) {
+        if (!magBins[(size_t)i]) continue;
+        long long bin = FloorDiv(i + MagTenthsMin, widthTenths);
+        if (bins.empty()) first = bin;
+        while ((long long)bins.size() <= bin - first) {
+            bins.push_back({(double)((first + (long long)bins.size()) * widthTenths) / 10.0, 0});
+        }
+        bins[(size_t)(bin - first)].count += magBins[(size_t)i];
+    }
+    return bins;
+}
+
+std::vector<RegionStats> QuakeAggregates::TopRegions(bool byMag, size_t limit) const {
+    std::vector<RegionStats> out = regions;
+    auto less = [byMag](const RegionStats& a, const RegionStats& b) {
+        if (byMag && a.maxMag != b.maxMag) return a.maxMag > b.maxMag;
+        if (a.count != b.count) return a.count > b.count;
+        return a.name < b.name;
+    };
+    if (limit && limit < out.size()) {
+        std::partial_sort(out.begin(), out.begin() + (ptrdiff_t)limit, out.end(), less);
+        out.resize(limit);
+    } else {
+        std::sort(out.begin(), out.end(), less);
+    }
+    return out;
+}
+
+std::pair<QuakeAggregates::MinuteIt, QuakeAggregates::MinuteIt> QuakeAggregates::MinuteRange(long long startMs, long long endMs) const {
+    auto begin = std::lower_bound(minutes.begin(), minutes.end(), std::make_pair(FloorDiv(startMs, MinuteMs) * MinuteMs, 0u));
+    auto end = std::upper_bound(minutes.begin(), minutes.end(), std::make_pair(endMs, UINT32_MAX));
+    return {begin, std::max(begin, end)};
+}
+
+size_t QuakeAggregates::RateBuckets(long long bucketMs, long long startMs, long long endMs) const {
+    auto [begin, end] = MinuteRange(startMs, endMs);
+    if (begin == end) return 0;
+    return (size_t)(FloorDiv(std::prev(end)->first, bucketMs) - FloorDiv(begin->first, bucketMs)) + 1;
+}
+
+std::vector<QuakeAggregates::Bucket> QuakeAggregates::Rate(long long bucketMs, long long startMs, long long endMs) const {
+    std::vector<Bucket> out(std::min(RateBuckets(bucketMs, startMs, endMs), MaxRateBuckets));
+    auto [begin, end] = MinuteRange(startMs, endMs);
+    if (out.empty()) return out;
+    long long first = FloorDiv(begin->first, bucketMs);
+    for (size_t i = 0; i < out.size(); i++) out[i].startMs = (first + (long long)i) * bucketMs;
+    for (auto it = begin; it != end; ++it) {
+        size_t i = (size_t)(FloorDiv(it->first, bucketMs) - first);
+        if (i >= out.size()) break;
+        out[i].count += it->second;
+    }
+    return out;
+}
+
+void QuakeAggregator::Apply(const QuakeChangeSet& changes) {
+    for (const auto& id : changes.removed) remove(id);
+    for (const auto& q : changes.updated) { remove(q.id); add(q); }
+    for (const auto& q : changes.inserted) { remove(q.id); add(q); }
+}
+
+std::shared_ptr<const QuakeAggregates> QuakeAggregator::Publish() const {
+    auto out = std::make_shared<QuakeAggregates>();
+    out->total = m_byId.size();
+    out->magBins = m_magBins;
+    out->regions.reserve(m_regions.size());
+    for (const auto& [name, region] : m_regions) {
+        out->regions.push_back({name, (int)region.count, region.mags.rbegin()->first});
+    }
+    out->minutes.assign(m_minutes.begin(), m_minutes.end());
+    return out;
+}
+
+void QuakeAggregator::add(const Earthquake& q) {
+    Contribution c{QuakeAggregates::MagBin(q.mag), q.mag, QuakeStats::ExtractRegion(q.place),
+                   FloorDiv(q.time_ms, QuakeAggregates::MinuteMs) * QuakeAggregates::MinuteMs};
+    m_magBins[(size_t)c.magBin]++;
+    Region& region = m_regions[c.region];
+    region.count++;
+    region.mags[c.mag]++;
+    m_minutes[c.minuteMs]++;
+    m_byId.emplace(q.id, std::move(c));
+}
+
+void QuakeAggregator::remove(const std::string& id) {
+    auto it = m_byId.find(id);
+    if (it == m_byId.end()) return;
+    const Contribution& c = it->second;
+    m_magBins[(size_t)c.magBin]--;
+
+    auto region = m_regions.find(c.region);
+    if (--region->second.count == 0) {
+        m_regions.erase(region);
+    } else {
+        auto mag = region->second.mags.find(c.mag);
+        if (--mag->second == 0) region->second.mags.erase(mag);
+    }
+    auto minute = m_minutes.find(c.minuteMs);
+    if (--minute->second == 0) m_minutes.erase(minute);
+    m_byId.erase(it);
+}
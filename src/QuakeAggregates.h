@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "QuakeStats.h"
+
+// Summary statistics of one snapshot behind the /stats endpoints: counts
+// per 0.1 magnitude, per region (count and max magnitude) and per minute.
+// Requests re-bin these, so their cost depends on the number of regions
+// and minutes, never on the number of events. Read-only once published.
+struct QuakeAggregates {
+    static constexpr int MagTenthsMin = -20;          // first bin is [-2.0, -1.9)
+    static constexpr int MagBins = 120;               // last bin is [9.9, 10.0); outliers are clamped
+    static constexpr long long MinuteMs = 60000;
+    static constexpr size_t MaxRateBuckets = 10000;
+
+    struct Bin {
+        double min = 0;
+        uint32_t count = 0;
+    };
+
+    struct Bucket {
+        long long startMs = 0;
+        uint32_t count = 0;
+    };
+
+    size_t total = 0;
+    std::array<uint32_t, MagBins> magBins{};
+    std::vector<RegionStats> regions;                            // region-name order
+    std::vector<std::pair<long long, uint32_t>> minutes;         // non-empty minutes, ascending
+
+    // Bins `widthTenths` tenths of a magnitude wide, aligned to 0, from the
+    // lowest non-empty bin to the highest.
+    std::vector<Bin> Histogram(int widthTenths) const;
+
+    // Regions by descending count (or max magnitude), ties by name; limit 0 = all.
+    std::vector<RegionStats> TopRegions(bool byMag, size_t limit) const;
+
+    // Counts per `bucketMs` (a multiple of MinuteMs) aligned to the epoch,
+    // empty buckets included, for the minutes overlapping [startMs, endMs].
+    // At most MaxRateBuckets; RateBuckets() tells the full count up front.
+    std::vector<Bucket> Rate(long long bucketMs, long long startMs, long long endMs) const;
+    size_t RateBuckets(long long bucketMs, long long startMs, long long endMs) const;
+
+    static int MagBin(double mag);
+
+private:
+    using MinuteIt = std::vector<std::pair<long long, uint32_t>>::const_iterator;
+    std::pair<MinuteIt, MinuteIt> MinuteRange(long long startMs, long long endMs) const;
+};
+
+// Running totals behind QuakeAggregates, updated from each change set in
+// O(changes). Remembers what every stored event contributed so updates and
+// removals can be subtracted again. Single writer (the publisher).
+class QuakeAggregator {
+public:
+    void Apply(const QuakeChangeSet& changes);
+
+    // Copy of the current totals for a new snapshot.
+    std::shared_ptr<const QuakeAggregates> Publish() const;
+
+private:
+    struct Contribution {
+        int magBin;
+        double mag;
+        std::string region;
+        long long minuteMs;
+    };
+
+    struct Region {
+        uint32_t count = 0;
+        std::map<double, uint32_t> mags;   // multiset; rbegin() is the max
+    };
+
+    void add(const Earthquake& q);
+    void remove(const std::string& id);
+
+    std::unordered_map<std::string, Contribution> m_byId;
+    std::array<uint32_t, QuakeAggregates::MagBins> m_magBins{};
+    std::map<std::string, Region> m_regions;
+    std::map<long long, uint32_t> m_minutes;
+};
@@ -0,0 +1,67 @@
+#include "QuakeBinary.h"
+#include "AcceptList.h"
+
+QuakeBinary::Format QuakeBinary::Negotiate(const std::string& accept) {
+    Format best = Format::Json;
+    double bestQ = 0.0;
+    for (const auto& entry : AcceptList::Parse(accept)) {
+        Format format;
+        const std::string& type = entry.value;
+        if (type == "application/cbor") format = Format::Cbor;
+        else if (type == "application/msgpack" || type == "application/x-msgpack" || type == "application/vnd.msgpack") format = Format::MsgPack;
+        else if (type == "application/json") format = Format::Json;
+        else continue;
+        // Earlier entries win ties, so "cbor, json" picks CBOR
+        if (entry.q > bestQ) { best = format; bestQ = entry.q; }
+    }
+    return best;
+}
+
+const char* QuakeBinary::ContentType(Format format) {
+    switch (format) {
+        case Format::Cbor: return "application/cbor";
+        case Format::MsgPack: return "application/msgpack";
+        default: return "application/json";
+    }
+}
+
+const char* QuakeBinary::KeySuffix(Format format) {
+    switch (format) {
+        case Format::Cbor: return "#cbor";
+        case Format::MsgPack: return "#msgpack";
+        default: return "";
+    }
+}
+
+nlohmann::json QuakeBinary::Quake(const Earthquake& q) {
+    return nlohmann::json{{"id", q.id}, {"mag", q.mag}, {"place", q.place}, {"time", q.time_ms},
+                          {"lon", q.lon}, {"lat", q.lat}, {"depth", q.depth_km}};
+}
+
+nlohmann::json QuakeBinary::QueryResult(const QuakeSnapshot& snapshot, const QuakeQueryResult& result, const QuakeQuery& query) {
+    nlohmann::json quakes = nlohmann::json::array();
+    for (uint32_t i : result.items) quakes.push_back(Quake(snapshot.quakes[i]));
+    return nlohmann::json{{"version", snapshot.version}, {"total", result.total}, {"offset", query.offset},
+                          {"limit", query.limit}, {"quakes", std::move(quakes)}};
+}
+
+nlohmann::json QuakeBinary::Changes(const QuakeSnapshot& snapshot, unsigned long long epoch, uint64_t since, const QuakeChangeSet& changes) {
+    nlohmann::json inserted = nlohmann::json::array(), updated = nlohmann::json::array();
+    for (const auto& q : changes.inserted) inserted.push_back(Quake(q));
+    for (const auto& q : changes.updated) updated.push_back(Quake(q));
+    return nlohmann::json{{"epoch", epoch}, {"version", snapshot.version}, {"since", since}, {"full", false},
+                          {"inserted", std::move(inserted)}, {"updated", std::move(updated)}, {"removed", changes.removed}};
+}
+
+nlohmann::json QuakeBinary::FullSync(const QuakeSnapshot& snapshot, unsigned long long epoch) {
+    nlohmann::json quakes = nlohmann::json::array();
+    for (const auto& q : snapshot.quakes) quakes.push_back(Quake(q));
+    return nlohmann::json{{"epoch", epoch}, {"version", snapshot.version}, {"full", true}, {"quakes", std::move(quakes)}};
+}
+
+std::string QuakeBinary::Encode(const nlohmann::json& doc, Format format) {
+    std::string out;
+    if (format == Format::Cbor) nlohmann::json::to_cbor(doc, out);
+    else nlohmann::json::to_msgpack(doc, out);
+    return out;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include "json.hpp"
+#include "EarthquakeService.h"
+#include "QuakeIndex.h"
+
+// CBOR / MessagePack bodies for the bulk endpoints, negotiated through the
+// Accept header. The documents have the same fields as the JSON writers in
+// QuakeJson; they are built from the snapshot directly, not by reparsing
+// the JSON text.
+class QuakeBinary {
+public:
+    enum class Format { Json, Cbor, MsgPack };
+
+    // Highest-q supported type in an Accept header. JSON when the header is
+    // absent, wildcard only, or names nothing we encode.
+    static Format Negotiate(const std::string& accept);
+
+    static const char* ContentType(Format format);
+
+    // Appended to a response cache key so each encoding is cached (and
+    // tagged) separately. Empty for JSON, which keeps its existing keys.
+    static const char* KeySuffix(Format format);
+
+    static nlohmann::json QueryResult(const QuakeSnapshot& snapshot, const QuakeQueryResult& result, const QuakeQuery& query);
+    static nlohmann::json Changes(const QuakeSnapshot& snapshot, unsigned long long epoch, uint64_t since, const QuakeChangeSet& changes);
+    static nlohmann::json FullSync(const QuakeSnapshot& snapshot, unsigned long long epoch);
+
+    // CBOR or MessagePack bytes of `doc` (`format` must not be Json)
+    static std::string Encode(const nlohmann::json& doc, Format format);
+
+private:
+    static nlohmann::json Quake(const Earthquake& q);
+};
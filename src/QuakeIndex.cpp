@@ -0,0 +1,268 @@
+#include "QuakeIndex.h"
+#include "EarthquakeService.h"
+#include "QuakeStats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+
+namespace {
+
+bool ParseDouble(const std::string& s, double& out) {
+    if (s.empty()) return false;
+    char* end = nullptr;
+    out = std::strtod(s.c_str(), &end);
+    return *end == '\0' && std::isfinite(out);
+}
+
+bool ParseInt(const std::string& s, long long& out) {
+    if (s.empty()) return false;
+    char* end = nullptr;
+    out = std::strtoll(s.c_str(), &end, 10);
+    return *end == '\0';
+}
+
+double DistanceKm(double lat1, double lon1, double lat2, double lon2) {
+    const double toRad = 3.14159265358979323846 / 180.0;
+    double dLat = (lat2 - lat1) * toRad, dLon = (lon2 - lon1) * toRad;
+    double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
+               std::cos(lat1 * toRad) * std::cos(lat2 * toRad) * std::sin(dLon / 2) * std::sin(dLon / 2);
+    return 2.0 * 6371.0088 * std::asin(std::min(1.0, std::sqrt(a)));
+}
+
+} // namespace
+
+bool QuakeQuery::Matches(const Earthquake& e) const {
+    const QuakeQuery& q = *this;
+    if (e.mag < q.minMag || e.mag > q.maxMag) return false;
+    if (e.time_ms < q.startMs || e.time_ms > q.endMs) return false;
+    if (q.hasBox) {
+        if (e.lat < q.minLat || e.lat > q.maxLat) return false;
+        bool inLon = q.minLon <= q.maxLon ? (e.lon >= q.minLon && e.lon <= q.maxLon)
+                                          : (e.lon >= q.minLon || e.lon <= q.maxLon);
+        if (!inLon) return false;
+    }
+    if (q.hasRadius && DistanceKm(q.centerLat, q.centerLon, e.lat, e.lon) > q.radiusKm) return false;
+    if (!q.place.empty() && !QuakeStats::ContainsCaseInsensitive(e.place, q.place)) return false;
+    return true;
+}
+
+namespace {
+
+// Same orderings the sorted indexes are built with, so a walk over an
+// index and a sort of scattered matches agree on ties.
+bool LessTime(const std::vector<Earthquake>& v, uint32_t a, uint32_t b) {
+    if (v[a].time_ms != v[b].time_ms) return v[a].time_ms < v[b].time_ms;
+    return a < b;
+}
+
+bool LessMag(const std::vector<Earthquake>& v, uint32_t a, uint32_t b) {
+    if (v[a].mag != v[b].mag) return v[a].mag < v[b].mag;
+    return LessTime(v, a, b);
+}
+
+} // namespace
+
+bool QuakeQuery::Parse(const std::map<std::string, std::string>& params, QuakeQuery& out, std::string& error) {
+    auto get = [&](const char* key) -> const std::string* {
+        auto it = params.find(key);
+        return it == params.end() ? nullptr : &it->second;
+    };
+    auto number = [&](const char* key, double& v) {
+        const std::string* s = get(key);
+        if (s && !ParseDouble(*s, v)) { error = std::string("invalid ") + key; return false; }
+        return true;
+    };
+    auto integer = [&](const char* key, long long& v) {
+        const std::string* s = get(key);
+        if (s && !ParseInt(*s, v)) { error = std::string("invalid ") + key; return false; }
+        return true;
+    };
+
+    if (!number("minmag", out.minMag) || !number("maxmag", out.maxMag)) return false;
+    if (!integer("start", out.startMs) || !integer("end", out.endMs)) return false;
+
+    if (const std::string* box = get("bbox")) {
+        double v[4];
+        size_t pos = 0;
+        for (int i = 0; i < 4; i++) {
+            size_t comma = i < 3 ? box->find(',', pos) : box->size();
+            if (comma == std::string::npos || !ParseDouble(box->substr(pos, comma - pos), v[i])) {
+                error = "bbox must be minLon,minLat,maxLon,maxLat";
+                return false;
+            }
+            pos = comma + 1;
+        }
+        out.hasBox = true;
+        out.minLon = v[0]; out.minLat = v[1]; out.maxLon = v[2]; out.maxLat = v[3];
+    }
+
+    if (get("radius") || get("lat") || get("lon")) {
+        if (!get("radius") || !get("lat") || !get("lon")) { error = "radius needs lat, lon and radius"; return false; }
+        if (!number("lat", out.centerLat) || !number("lon", out.centerLon) || !number("radius", out.radiusKm)) return false;
+        if (out.radiusKm < 0.0) { error = "invalid radius"; return false; }
+        out.hasRadius = true;
+    }
+
+    if (const std::string* place = get("place")) out.place = *place;
+
+    if (const std::string* sort = get("sort")) {
+        if (*sort == "-time") out.sort = Sort::TimeDesc;
+        else if (*sort == "time") out.sort = Sort::TimeAsc;
+        else if (*sort == "-mag") out.sort = Sort::MagDesc;
+        else if (*sort == "mag") out.sort = Sort::MagAsc;
+        else { error = "sort must be time, -time, mag or -mag"; return false; }
+    }
+
+    long long limit = (long long)DefaultLimit, offset = 0;
+    if (!integer("limit", limit) || !integer("offset", offset)) return false;
+    if (limit < 0 || offset < 0) { error = "limit and offset must be non-negative"; return false; }
+    out.limit = std::min((size_t)limit, MaxLimit);
+    out.offset = (size_t)offset;
+    return true;
+}
+
+std::string QuakeQuery::Key() const {
+    char buf[320];
+    int n = std::snprintf(buf, sizeof(buf), "m%.17g,%.17g;t%lld,%lld;b%d,%.17g,%.17g,%.17g,%.17g;r%d,%.17g,%.17g,%.17g;s%d;l%zu;o%zu;p",
+                          minMag, maxMag, startMs, endMs, hasBox ? 1 : 0, minLon, minLat, maxLon, maxLat,
+                          hasRadius ? 1 : 0, centerLat, centerLon, radiusKm, (int)sort, limit, offset);
+    // Place goes last, so it can hold any characters without ambiguity
+    return std::string(buf, (size_t)std::min(n, (int)sizeof(buf) - 1)) + place;
+}
+
+QuakeIndex::QuakeIndex(const std::vector<Earthquake>& quakes) {
+    const uint32_t n = (uint32_t)quakes.size();
+
+    m_byTime.resize(n);
+    std::iota(m_byTime.begin(), m_byTime.end(), 0u);
+    std::sort(m_byTime.begin(), m_byTime.end(), [&](uint32_t a, uint32_t b) { return LessTime(quakes, a, b); });
+    m_times.reserve(n);
+    for (uint32_t i : m_byTime) m_times.push_back(quakes[i].time_ms);
+
+    m_byMag.resize(n);
+    std::iota(m_byMag.begin(), m_byMag.end(), 0u);
+    std::sort(m_byMag.begin(), m_byMag.end(), [&](uint32_t a, uint32_t b) { return LessMag(quakes, a, b); });
+    m_mags.reserve(n);
+    for (uint32_t i : m_byMag) m_mags.push_back(quakes[i].mag);
+
+    // Counting sort into cells (CSR)
+    const size_t cellCount = (size_t)GridCols * GridRows;
+    m_cellStart.assign(cellCount + 1, 0);
+    std::vector<uint32_t> cellOf(n);
+    for (uint32_t i = 0; i < n; i++) {
+        cellOf[i] = (uint32_t)(CellY(quakes[i].lat) * GridCols + CellX(quakes[i].lon));
+        m_cellStart[cellOf[i] + 1]++;
+    }
+    for (size_t c = 0; c < cellCount; c++) m_cellStart[c + 1] += m_cellStart[c];
+    m_cellItems.resize(n);
+    std::vector<uint32_t> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (uint32_t i = 0; i < n; i++) m_cellItems[fill[cellOf[i]]++] = i;
+}
+
+int QuakeIndex::CellX(double lon) {
+    return std::clamp((int)std::floor((lon + 180.0) / CellDeg), 0, GridCols - 1);
+}
+
+int QuakeIndex::CellY(double lat) {
+    return std::clamp((int)std::floor((90.0 - lat) / CellDeg), 0, GridRows - 1);
+}
+
+void QuakeIndex::CollectCells(const QuakeQuery& q, std::vector<int>& cells) const {
+    double minLat, maxLat, minLon = -180.0, maxLon = 180.0;
+    bool allLon = false;
+    if (q.hasBox) {
+        minLat = q.minLat; maxLat = q.maxLat;
+        minLon = q.minLon; maxLon = q.maxLon;
+    } else {
+        // Bounding box of the circle; widen to all longitudes near the poles
+        double dLat = q.radiusKm / 111.195;
+        minLat = q.centerLat - dLat;
+        maxLat = q.centerLat + dLat;
+        double edgeLat = std::min(89.0, std::max(std::abs(minLat), std::abs(maxLat)));
+        double dLon = dLat / std::cos(edgeLat * 3.14159265358979323846 / 180.0);
+        allLon = minLat <= -90.0 || maxLat >= 90.0 || dLon >= 180.0;
+        minLon = q.centerLon - dLon;
+        maxLon = q.centerLon + dLon;
+        if (minLon < -180.0) minLon += 360.0;
+        if (maxLon > 180.0) maxLon -= 360.0;
+    }
+    if (minLat > maxLat) return;
+
+    std::vector<char> useCol(GridCols, 0);
+    if (allLon) {
+        std::fill(useCol.begin(), useCol.end(), 1);
+    } else if (minLon <= maxLon) {
+        for (int x = CellX(minLon); x <= CellX(maxLon); x++) useCol[x] = 1;
+    } else {
+        for (int x = CellX(minLon); x < GridCols; x++) useCol[x] = 1;
+        for (int x = 0; x <= CellX(maxLon); x++) useCol[x] = 1;
+    }
+
+    // Rows grow southwards
+    for (int y = CellY(maxLat); y <= CellY(minLat); y++) {
+        for (int x = 0; x < GridCols; x++) {
+            if (useCol[x]) cells.push_back(y * GridCols + x);
+        }
+    }
+}
+
+QuakeQueryResult QuakeIndex::Query(const std::vector<Earthquake>& quakes, const QuakeQuery& q) const {
+    QuakeQueryResult result;
+
+    // Candidate count per index
+    size_t t0 = std::lower_bound(m_times.begin(), m_times.end(), q.startMs) - m_times.begin();
+    size_t t1 = std::max(t0, (size_t)(std::upper_bound(m_times.begin(), m_times.end(), q.endMs) - m_times.begin()));
+    size_t m0 = std::lower_bound(m_mags.begin(), m_mags.end(), q.minMag) - m_mags.begin();
+    size_t m1 = std::max(m0, (size_t)(std::upper_bound(m_mags.begin(), m_mags.end(), q.maxMag) - m_mags.begin()));
+
+    std::vector<int> cells;
+    size_t spatialCount = SIZE_MAX;
+    if (q.hasBox || q.hasRadius) {
+        CollectCells(q, cells);
+        spatialCount = 0;
+        for (int c : cells) spatialCount += m_cellStart[c + 1] - m_cellStart[c];
+    }
+
+    enum class Driver { Time, Mag, Spatial } driver = Driver::Time;
+    size_t best = t1 - t0;
+    if (m1 - m0 < best) { driver = Driver::Mag; best = m1 - m0; }
+    if (spatialCount < best) { driver = Driver::Spatial; }
+
+    const size_t windowEnd = q.offset + q.limit;
+    bool timeSort = q.sort == QuakeQuery::Sort::TimeAsc || q.sort == QuakeQuery::Sort::TimeDesc;
+    bool descending = q.sort == QuakeQuery::Sort::TimeDesc || q.sort == QuakeQuery::Sort::MagDesc;
+
+    // Driving index already in the requested order: keep only the window
+    if ((driver == Driver::Time && timeSort) || (driver == Driver::Mag && !timeSort)) {
+        const std::vector<uint32_t>& order = driver == Driver::Time ? m_byTime : m_byMag;
+        size_t lo = driver == Driver::Time ? t0 : m0, hi = driver == Driver::Time ? t1 : m1;
+        for (size_t k = 0; k < hi - lo; k++) {
+            uint32_t i = order[descending ? hi - 1 - k : lo + k];
+            if (!q.Matches(quakes[i])) continue;
+            if (result.total >= q.offset && result.total < windowEnd) result.items.push_back(i);
+            result.total++;
+        }
+        return result;
+    }
+
+    std::vector<uint32_t> matches;
+    auto consider = [&](uint32_t i) { if (q.Matches(quakes[i])) matches.push_back(i); };
+    if (driver == Driver::Time) for (size_t k = t0; k < t1; k++) consider(m_byTime[k]);
+    else if (driver == Driver::Mag) for (size_t k = m0; k < m1; k++) consider(m_byMag[k]);
+    else for (int c : cells) for (uint32_t k = m_cellStart[c]; k < m_cellStart[c + 1]; k++) consider(m_cellItems[k]);
+
+    result.total = matches.size();
+    if (q.offset >= matches.size()) return result;
+
+    auto before = [&](uint32_t a, uint32_t b) {
+        bool less = timeSort ? LessTime(quakes, a, b) : LessMag(quakes, a, b);
+        bool greater = timeSort ? LessTime(quakes, b, a) : LessMag(quakes, b, a);
+        return descending ? greater : less;
+    };
+    size_t keep = std::min(windowEnd, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + keep, matches.end(), before);
+    result.items.assign(matches.begin() + q.offset, matches.begin() + keep);
+    return result;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+struct Earthquake;
+
+// Parameters of GET /quakes. Unset ranges are open-ended.
+struct QuakeQuery {
+    enum class Sort { TimeDesc, TimeAsc, MagDesc, MagAsc };
+
+    static constexpr size_t DefaultLimit = 100;
+    static constexpr size_t MaxLimit = 1000000;   // large pages are streamed, not cached
+
+    double minMag = -std::numeric_limits<double>::infinity();
+    double maxMag = std::numeric_limits<double>::infinity();
+    long long startMs = std::numeric_limits<long long>::min();
+    long long endMs = std::numeric_limits<long long>::max();
+
+    bool hasBox = false;            // minLon > maxLon crosses the antimeridian
+    double minLon = 0, minLat = 0, maxLon = 0, maxLat = 0;
+
+    bool hasRadius = false;         // great-circle distance from (lat, lon)
+    double centerLat = 0, centerLon = 0, radiusKm = 0;
+
+    std::string place;              // case-insensitive substring
+    Sort sort = Sort::TimeDesc;
+    size_t limit = DefaultLimit;
+    size_t offset = 0;
+
+    // minmag, maxmag, start, end (epoch ms), bbox=minLon,minLat,maxLon,maxLat,
+    // lat+lon+radius (km), place, sort=time|-time|mag|-mag, limit, offset.
+    // Returns false and fills `error` on a malformed parameter.
+    static bool Parse(const std::map<std::string, std::string>& params, QuakeQuery& out, std::string& error);
+
+    // Canonical form: equal for queries that select the same page.
+    std::string Key() const;
+
+    // True if `e` passes every filter (sort and paging aside).
+    bool Matches(const Earthquake& e) const;
+};
+
+struct QuakeQueryResult {
+    size_t total = 0;               // matches before offset/limit
+    std::vector<uint32_t> items;    // indices into the snapshot's quakes, in sort order
+};
+
+// Read-only indexes over one snapshot: events sorted by time and by
+// magnitude plus a 5-degree spatial grid. A query walks whichever index
+// yields the fewest candidates and checks the remaining predicates on
+// those only. Built once per published snapshot, then shared by all
+// request threads without locking.
+class QuakeIndex {
+public:
+    static constexpr double CellDeg = 5.0;
+    static constexpr int GridCols = 72;
+    static constexpr int GridRows = 36;
+
+    explicit QuakeIndex(const std::vector<Earthquake>& quakes);
+
+    // `quakes` must be the vector the index was built from.
+    QuakeQueryResult Query(const std::vector<Earthquake>& quakes, const QuakeQuery& q) const;
+
+private:
+    static int CellX(double lon);
+    static int CellY(double lat);
+
+    // Grid cells overlapping the query's box / radius, appended to `cells`.
+    void CollectCells(const QuakeQuery& q, std::vector<int>& cells) const;
+
+    std::vector<uint32_t> m_byTime;      // ascending time
+    std::vector<long long> m_times;      // m_times[i] = time of m_byTime[i]
+    std::vector<uint32_t> m_byMag;       // ascending magnitude
+    std::vector<double> m_mags;
+
+    std::vector<uint32_t> m_cellStart;   // CSR offsets, GridCols * GridRows + 1
+    std::vector<uint32_t> m_cellItems;
+};
@@ -0,0 +1,179 @@
+#include "QuakeJson.h"
+#include <cmath>
+#include <cstdio>
+
+void QuakeJson::AppendString(std::string& out, const std::string& s) {
+    out += '"';
+    for (char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)(unsigned char)c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+void QuakeJson::AppendNumber(std::string& out, double v) {
+    if (!std::isfinite(v)) { out += "null"; return; }
+    char buf[32];
+    int n = std::snprintf(buf, sizeof(buf), "%.15g", v);
+    out.append(buf, (size_t)n);
+}
+
+void QuakeJson::AppendQuake(std::string& out, const Earthquake& q) {
+    out += "{\"id\":";
+    AppendString(out, q.id);
+    out += ",\"mag\":";
+    AppendNumber(out, q.mag);
+    out += ",\"place\":";
+    AppendString(out, q.place);
+    out += ",\"time\":";
+    out += std::to_string(q.time_ms);
+    out += ",\"lon\":";
+    AppendNumber(out, q.lon);
+    out += ",\"lat\":";
+    AppendNumber(out, q.lat);
+    out += ",\"depth\":";
+    AppendNumber(out, q.depth_km);
+    out += '}';
+}
+
+void QuakeJson::AppendArray(std::string& out, const std::vector<const Earthquake*>& quakes) {
+    out += '[';
+    for (size_t i = 0; i < quakes.size(); i++) {
+        if (i) out += ',';
+        AppendQuake(out, *quakes[i]);
+    }
+    out += ']';
+}
+
+void QuakeJson::AppendQueryHead(std::string& out, const QuakeSnapshot& snapshot, const QuakeQueryResult& result, const QuakeQuery& query) {
+    out += "{\"version\":" + std::to_string(snapshot.version) + ",\"total\":" + std::to_string(result.total) +
+           ",\"offset\":" + std::to_string(query.offset) + ",\"limit\":" + std::to_string(query.limit) + ",\"quakes\":[";
+}
+
+std::string QuakeJson::QueryResult(const QuakeSnapshot& snapshot, const QuakeQueryResult& result, const QuakeQuery& query) {
+    std::string out;
+    out.reserve(96 + result.items.size() * 160);
+    AppendQueryHead(out, snapshot, result, query);
+    for (size_t i = 0; i < result.items.size(); i++) {
+        if (i) out += ',';
+        AppendQuake(out, snapshot.quakes[result.items[i]]);
+    }
+    out += "]}";
+    return out;
+}
+
+std::string QuakeJson::Changes(const QuakeSnapshot& snapshot, unsigned long long epoch, uint64_t since, const QuakeChangeSet& changes) {
+    std::string out;
+    out.reserve(128 + (changes.inserted.size() + changes.updated.size()) * 160 + changes.removed.size() * 16);
+    out += "{\"epoch\":" + std::to_string(epoch) + ",\"version\":" + std::to_string(snapshot.version) +
+           ",\"since\":" + std::to_string(since) + ",\"full\":false,\"inserted\":[";
+    for (size_t i = 0; i < changes.inserted.size(); i++) {
+        if (i) out += ',';
+        AppendQuake(out, changes.inserted[i]);
+    }
+    out += "],\"updated\":[";
+    for (size_t i = 0; i < changes.updated.size(); i++) {
+        if (i) out += ',';
+        AppendQuake(out, changes.updated[i]);
+    }
+    out += "],\"removed\":[";
+    for (size_t i = 0; i < changes.removed.size(); i++) {
+        if (i) out += ',';
+        AppendString(out, changes.removed[i]);
+    }
+    out += "]}";
+    return out;
+}
+
+std::string QuakeJson::FullSync(const QuakeSnapshot& snapshot, unsigned long long epoch) {
+    std::string out;
+    out.reserve(96 + snapshot.quakes.size() * 160);
+    out += "{\"epoch\":" + std::to_string(epoch) + ",\"version\":" + std::to_string(snapshot.version) +
+           ",\"full\":true,\"quakes\":[";
+    for (size_t i = 0; i < snapshot.quakes.size(); i++) {
+        if (i) out += ',';
+        AppendQuake(out, snapshot.quakes[i]);
+    }
+    out += "]}";
+    return out;
+}
+
+namespace {
+
+void AppendStatsHead(std::string& out, const QuakeSnapshot& snapshot) {
+    out += "{\"version\":" + std::to_string(snapshot.version) +
+           ",\"total\":" + std::to_string(snapshot.aggregates->total);
+}
+
+} // namespace
+
+std::string QuakeJson::Histogram(const QuakeSnapshot& snapshot, double width, const std::vector<QuakeAggregates::Bin>& bins) {
+    std::string out;
+    AppendStatsHead(out, snapshot);
+    out += ",\"width\":";
+    AppendNumber(out, width);
+    out += ",\"bins\":[";
+    for (size_t i = 0; i < bins.size(); i++) {
+        out += i ? ",{\"min\":" : "{\"min\":";
+        AppendNumber(out, bins[i].min);
+        out += ",\"count\":" + std::to_string(bins[i].count) + "}";
+    }
+    out += "]}";
+    return out;
+}
+
+std::string QuakeJson::Regions(const QuakeSnapshot& snapshot, const std::vector<RegionStats>& regions) {
+    std::string out;
+    AppendStatsHead(out, snapshot);
+    out += ",\"regions\":[";
+    for (size_t i = 0; i < regions.size(); i++) {
+        out += i ? ",{\"region\":" : "{\"region\":";
+        AppendString(out, regions[i].name);
+        out += ",\"count\":" + std::to_string(regions[i].count) + ",\"maxMag\":";
+        AppendNumber(out, regions[i].maxMag);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
+
+std::string QuakeJson::Rate(const QuakeSnapshot& snapshot, long long bucketMs, const std::vector<QuakeAggregates::Bucket>& buckets) {
+    std::string out;
+    out.reserve(64 + buckets.size() * 36);
+    AppendStatsHead(out, snapshot);
+    out += ",\"bucket\":" + std::to_string(bucketMs / 1000) + ",\"buckets\":[";
+    for (size_t i = 0; i < buckets.size(); i++) {
+        if (i) out += ',';
+        out += "{\"start\":" + std::to_string(buckets[i].startMs) + ",\"count\":" + std::to_string(buckets[i].count) + "}";
+    }
+    out += "]}";
+    return out;
+}
+
+std::string QuakeJson::Status(const QuakeSnapshot& snapshot) {
+    std::string json = "{\"status\": \"running\", \"version\": " + std::to_string(snapshot.version) +
+                       ", \"count\": " + std::to_string(snapshot.quakes.size());
+    if (!snapshot.quakes.empty()) {
+        const auto& q = snapshot.quakes[0];
+        json += ", \"latest\": {\"place\": ";
+        AppendString(json, q.place);
+        json += ", \"mag\": ";
+        AppendNumber(json, q.mag);
+        json += "}";
+    }
+    json += "}";
+    return json;
+}
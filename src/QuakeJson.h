@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "EarthquakeService.h"
+#include "QuakeIndex.h"
+#include "QuakeAggregates.h"
+
+// JSON writers for the API. Appends into a caller-owned string so large
+// responses are built with one growing buffer and no DOM.
+class QuakeJson {
+public:
+    // {"id":..,"mag":..,"place":..,"time":..,"lon":..,"lat":..,"depth":..}
+    static void AppendQuake(std::string& out, const Earthquake& q);
+
+    // [quake, quake, ...]
+    static void AppendArray(std::string& out, const std::vector<const Earthquake*>& quakes);
+
+    // {"version":..,"total":..,"offset":..,"limit":..,"quakes":[..]}
+    static std::string QueryResult(const QuakeSnapshot& snapshot, const QuakeQueryResult& result, const QuakeQuery& query);
+
+    // Everything of QueryResult up to the first quake; streamed responses
+    // follow it with comma-separated quakes and "]}"
+    static void AppendQueryHead(std::string& out, const QuakeSnapshot& snapshot, const QuakeQueryResult& result, const QuakeQuery& query);
+
+    // Delta for GET /quakes/changes:
+    // {"epoch":..,"version":..,"since":..,"full":false,"inserted":[..],"updated":[..],"removed":[ids]}
+    static std::string Changes(const QuakeSnapshot& snapshot, unsigned long long epoch, uint64_t since, const QuakeChangeSet& changes);
+
+    // Resync fallback of the same endpoint: {"epoch":..,"version":..,"full":true,"quakes":[all]}
+    static std::string FullSync(const QuakeSnapshot& snapshot, unsigned long long epoch);
+
+    // Body of GET /status
+    static std::string Status(const QuakeSnapshot& snapshot);
+
+    // Bodies of the /stats endpoints:
+    // {"version":..,"total":..,"width":..,"bins":[{"min":..,"count":..}]}
+    static std::string Histogram(const QuakeSnapshot& snapshot, double width, const std::vector<QuakeAggregates::Bin>& bins);
+    // {"version":..,"total":..,"regions":[{"region":..,"count":..,"maxMag":..}]}
+    static std::string Regions(const QuakeSnapshot& snapshot, const std::vector<RegionStats>& regions);
+    // {"version":..,"total":..,"bucket":seconds,"buckets":[{"start":..,"count":..}]}
+    static std::string Rate(const QuakeSnapshot& snapshot, long long bucketMs, const std::vector<QuakeAggregates::Bucket>& buckets);
+
+    static void AppendString(std::string& out, const std::string& s);
+    static void AppendNumber(std::string& out, double v);
+};
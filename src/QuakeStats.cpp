@@ -0,0 +1,74 @@
+#include "QuakeStats.h"
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <unordered_set>
+
+std::string QuakeStats::ExtractRegion(const std::string& place) {
+    // All US States for grouping
+    static const std::unordered_set<std::string> usStates = {
+        "AL", "AK", "AZ", "AR", "CA", "CO", "CT", "DE", "FL", "GA", "HI", "ID", "IL", "IN", "IA", "KS", "KY", "LA", "ME", "MD",
+        "MA", "MI", "MN", "MS", "MO", "MT", "NE", "NV", "NH", "NJ", "NM", "NY", "NC", "ND", "OH", "OK", "OR", "PA", "RI", "SC",
+        "SD", "TN", "TX", "UT", "VT", "VA", "WA", "WV", "WI", "WY", "Alabama", "Alaska", "Arizona", "Arkansas", "California",
+        "Colorado", "Connecticut", "Delaware", "Florida", "Georgia", "Hawaii", "Idaho", "Illinois", "Indiana", "Iowa", "Kansas",
+        "Kentucky", "Louisiana", "Maine", "Maryland", "Massachusetts", "Michigan", "Minnesota", "Mississippi", "Missouri", "Montana",
+        "Nebraska", "Nevada", "New Hampshire", "New Jersey", "New Mexico", "New York", "North Carolina", "North Dakota", "Ohio",
+        "Oklahoma", "Oregon", "Pennsylvania", "Rhode Island", "South Carolina", "South Dakota", "Tennessee", "Texas", "Utah",
+        "Vermont", "Virginia", "Washington", "West Virginia", "Wisconsin", "Wyoming", "Puerto Rico"
+    };
+
+    // Text after the last comma; the whole place when that is blank
+    auto trimmed = [&](size_t b, size_t e) {
+        while (b < e && std::isspace((unsigned char)place[b])) b++;
+        while (e > b && (std::isspace((unsigned char)place[e - 1]) || place[e - 1] == ',')) e--;
+        return place.substr(b, e - b);
+    };
+    size_t lastComma = place.find_last_of(',');
+    std::string region = lastComma == std::string::npos ? "" : trimmed(lastComma + 1, place.size());
+    if (region.empty()) region = trimmed(0, place.size());
+    if (region.empty()) return "Unknown";
+
+    // Normalize US locations
+    bool isUSA = false;
+    for (const auto& s : usStates) {
+        if (region == s || region.find(s) != std::string::npos) { isUSA = true; break; }
+    }
+    if (isUSA) region = "USA";
+
+    // Cleanup trailing junk
+    size_t extra = region.find(" region");
+    if (extra != std::string::npos) region = region.substr(0, extra);
+    extra = region.find(" offshore");
+    if (extra != std::string::npos) region = region.substr(0, extra);
+    return region;
+}
+
+bool QuakeStats::ContainsCaseInsensitive(const std::string& text, const std::string& query) {
+    if (query.empty()) return true;
+    auto it = std::search(text.begin(), text.end(), query.begin(), query.end(), [](char a, char b) { return std::tolower(a) == std::tolower(b); });
+    return it != text.end();
+}
+
+std::vector<RegionStats> QuakeStats::ByRegion(const std::vector<Earthquake>& quakes, const std::vector<std::string>& regions) {
+    std::map<std::string, RegionStats> statsMap;
+    for (size_t i = 0; i < quakes.size() && i < regions.size(); i++) {
+        auto& entry = statsMap[regions[i]];
+        entry.name = regions[i]; entry.count++;
+        if (quakes[i].mag > entry.maxMag) entry.maxMag = quakes[i].mag;
+    }
+
+    std::vector<RegionStats> result;
+    result.reserve(statsMap.size());
+    for (auto& [name, s] : statsMap) result.push_back(std::move(s));
+    return result;
+}
+
+float QuakeStats::MagnitudeHistogram(const std::vector<Earthquake>& quakes, float (&bins)[HistogramBins]) {
+    std::fill(std::begin(bins), std::end(bins), 0.0f);
+    float maxH = 0.0f;
+    for (const auto& q : quakes) {
+        int bin = (int)q.mag;
+        if (bin >= 0 && bin < HistogramBins) { bins[bin]++; if (bins[bin] > maxH) maxH = bins[bin]; }
+    }
+    return maxH;
+}
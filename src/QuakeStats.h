@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "EarthquakeService.h"
+
+struct RegionStats {
+    std::string name;
+    int count = 0;
+    double maxMag = 0.0;
+};
+
+// Filtering and aggregation shared by the GUI, the daemon and the benchmarks.
+class QuakeStats {
+public:
+    static constexpr int HistogramBins = 10;
+
+    // Region from "place" (e.g. "10 km W of Town, Chile" -> "Chile"); US states map to "USA".
+    // A blank place gives "Unknown"; never throws.
+    static std::string ExtractRegion(const std::string& place);
+
+    static bool ContainsCaseInsensitive(const std::string& text, const std::string& query);
+
+    // Per-region count and max magnitude; regions[i] belongs to quakes[i].
+    // Returned in region-name order.
+    static std::vector<RegionStats> ByRegion(const std::vector<Earthquake>& quakes, const std::vector<std::string>& regions);
+
+    // Counts per whole magnitude (bin 0 = M0.x ... bin 9 = M9.x); returns the largest bin.
+    static float MagnitudeHistogram(const std::vector<Earthquake>& quakes, float (&bins)[HistogramBins]);
+};
@@ -0,0 +1,91 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Per-client token buckets without locks. Clients hash into a fixed table
+// (open addressing, a few probes); each bucket is one 64-bit word holding
+// the last refill time and the remaining tokens, updated with a single
+// CAS. Buckets idle for IdleMs are recycled for new clients; when every
+// probed slot is busy the newcomer shares the stalest one, which can only
+// make limiting stricter, never looser.
+class ClientRateLimiter {
+public:
+    static constexpr size_t Slots = 4096;
+    static constexpr int Probes = 8;
+    static constexpr int64_t IdleMs = 60000;
+
+    // `rate` tokens per second refill up to `burst` (at most 16000)
+    ClientRateLimiter(double rate, double burst)
+        : m_ratePerMs(rate / 1000.0), m_burst((uint64_t)(std::min(burst, 16000.0) * 1000)),
+          m_start(std::chrono::steady_clock::now()) {}
+
+    // Takes a token for `client`. Returns 0 when admitted, otherwise the
+    // milliseconds until the next token.
+    int64_t Acquire(const std::string& client) {
+        uint64_t now = NowMs();
+        Slot& slot = Find(Hash(client), now);
+        uint64_t state = slot.state.load(std::memory_order_relaxed);
+        for (;;) {
+            uint64_t tokens = m_burst;   // unseen client starts full
+            if (state) {
+                uint64_t last = state >> TokenBits;
+                tokens = std::min(m_burst, (state & TokenMask) + (uint64_t)((double)(now - std::min(now, last)) * m_ratePerMs * 1000));
+            }
+            bool admitted = tokens >= 1000;
+            uint64_t next = (now << TokenBits) | (admitted ? tokens - 1000 : tokens);
+            if (slot.state.compare_exchange_weak(state, next, std::memory_order_relaxed)) {
+                if (admitted) return 0;
+                return m_ratePerMs > 0 ? (int64_t)((1000 - tokens) / (m_ratePerMs * 1000)) + 1 : IdleMs;
+            }
+        }
+    }
+
+private:
+    static constexpr int TokenBits = 24;                     // milli-tokens
+    static constexpr uint64_t TokenMask = (1ULL << TokenBits) - 1;
+
+    struct Slot {
+        std::atomic<uint64_t> key{0};      // client hash, 0 = free
+        std::atomic<uint64_t> state{0};    // last refill ms << TokenBits | milli-tokens, 0 = fresh
+    };
+
+    static uint64_t Hash(const std::string& s) {
+        uint64_t h = 1469598103934665603ULL;   // FNV-1a
+        for (unsigned char c : s) { h ^= c; h *= 1099511628211ULL; }
+        return h | 1;
+    }
+
+    uint64_t NowMs() const {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start).count() + 1;
+    }
+
+    Slot& Find(uint64_t key, uint64_t now) {
+        Slot* stalest = nullptr;
+        uint64_t stalestLast = UINT64_MAX;
+        for (int i = 0; i < Probes; i++) {
+            Slot& slot = m_slots[(key + (uint64_t)i) % Slots];
+            uint64_t k = slot.key.load(std::memory_order_relaxed);
+            if (k == key) return slot;
+            if (k == 0) {
+                if (slot.key.compare_exchange_strong(k, key, std::memory_order_relaxed)) return slot;
+                if (k == key) return slot;
+            }
+            uint64_t last = slot.state.load(std::memory_order_relaxed) >> TokenBits;
+            if (last < stalestLast) { stalest = &slot; stalestLast = last; }
+        }
+        uint64_t owner = stalest->key.load(std::memory_order_relaxed);
+        if (now - std::min(now, stalestLast) > (uint64_t)IdleMs &&
+            stalest->key.compare_exchange_strong(owner, key, std::memory_order_relaxed)) {
+            stalest->state.store(0, std::memory_order_relaxed);
+        }
+        return *stalest;
+    }
+
+    const double m_ratePerMs;
+    const uint64_t m_burst;            // milli-tokens
+    const std::chrono::steady_clock::time_point m_start;
+    Slot m_slots[Slots];
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include "Metrics.h"
+
+// One serialized API response. Immutable once cached.
+struct CachedResponse {
+    std::string contentType;
+    std::string body;
+    std::string contentEncoding;   // "gzip" for precompressed bodies, else empty
+};
+
+// Serialized responses for a single snapshot version, keyed by route plus
+// normalized query. Lives inside the snapshot, so it is dropped together
+// with the data it describes and never needs invalidating. Readers take a
+// shared lock only; the service's data lock is never involved.
+class ResponseCache {
+public:
+    static constexpr size_t MaxEntries = 512;
+    static constexpr size_t MaxBytes = 64 * 1024 * 1024;   // keys + bodies
+
+    std::shared_ptr<const CachedResponse> Find(const std::string& key) const {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto it = m_entries.find(key);
+        return it == m_entries.end() ? nullptr : it->second;
+    }
+
+    // Returns the cached entry for `key`, building it on a miss. Concurrent
+    // misses may both build; the first insert wins. A body that would take
+    // the cache past MaxEntries or MaxBytes is returned without being
+    // stored, so arbitrary query strings cost at most those bounds per
+    // snapshot (plus whatever in-flight requests still hold).
+    template <typename Build>
+    std::shared_ptr<const CachedResponse> GetOrBuild(const std::string& key, Build&& build) {
+        static const Metrics::Counter hits = Metrics::GetCounter("earthquake_response_cache_hits_total", "API responses served from the snapshot cache");
+        static const Metrics::Counter misses = Metrics::GetCounter("earthquake_response_cache_misses_total", "API responses serialized on a cache miss");
+        if (auto hit = Find(key)) {
+            hits.Add();
+            return hit;
+        }
+        misses.Add();
+        auto built = std::make_shared<const CachedResponse>(build());
+
+        size_t bytes = key.size() + built->body.size();
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if (m_entries.size() >= MaxEntries || bytes > MaxBytes - m_bytes) return built;
+        auto inserted = m_entries.emplace(key, std::move(built));
+        if (inserted.second) m_bytes += bytes;
+        return inserted.first->second;
+    }
+
+    size_t Size() const {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    size_t Bytes() const {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return m_bytes;
+    }
+
+private:
+    mutable std::shared_mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<const CachedResponse>> m_entries;
+    size_t m_bytes = 0;
+};
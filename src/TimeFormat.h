@@ -0,0 +1,115 @@
+#pragma once
+#include <ctime>
+#include <vector>
+#include <chrono>
+
+// Thread-safe, allocation-free timestamp formatting.
+// Output is always "YYYY-MM-DD HH:MM:SS" (19 chars + NUL).
+class TimeFormat {
+public:
+    static constexpr int BufferSize = 20;
+
+    static void FormatUTC(long long time_ms, char* out) {
+        WriteCivil(FloorDiv(time_ms, 1000), out);
+    }
+
+    static void FormatLocal(long long time_ms, char* out) {
+        long long secs = FloorDiv(time_ms, 1000);
+        WriteCivil(secs + OffsetTable().OffsetAt(secs), out);
+    }
+
+private:
+    // Local UTC offsets precomputed per hour around "now", so formatting
+    // the feed window (up to a month back) never touches the C time API.
+    // Lookups outside the window fall back to the reentrant libc calls.
+    class UtcOffsetTable {
+    public:
+        UtcOffsetTable() {
+            long long now = (long long)std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            m_firstHour = FloorDiv(now, 3600) - DaysBack * 24;
+            m_offsets.resize((DaysBack + DaysAhead) * 24);
+            for (size_t i = 0; i < m_offsets.size(); i++) {
+                m_offsets[i] = ComputeOffset((m_firstHour + (long long)i) * 3600);
+            }
+        }
+
+        int OffsetAt(long long secs) const {
+            long long idx = FloorDiv(secs, 3600) - m_firstHour;
+            if (idx >= 0 && idx < (long long)m_offsets.size()) return m_offsets[(size_t)idx];
+            return ComputeOffset(secs);
+        }
+
+    private:
+        static constexpr int DaysBack = 40;
+        static constexpr int DaysAhead = 2;
+
+        long long m_firstHour = 0;
+        std::vector<int> m_offsets;
+    };
+
+    static const UtcOffsetTable& OffsetTable() {
+        static const UtcOffsetTable table;
+        return table;
+    }
+
+    static long long FloorDiv(long long a, long long b) {
+        long long q = a / b;
+        return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+    }
+
+    // Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant).
+    static long long DaysFromCivil(long long y, unsigned m, unsigned d) {
+        y -= m <= 2;
+        long long era = (y >= 0 ? y : y - 399) / 400;
+        unsigned yoe = (unsigned)(y - era * 400);
+        unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + (long long)doe - 719468;
+    }
+
+    static int ComputeOffset(long long secs) {
+        std::time_t t = (std::time_t)secs;
+        std::tm lt{}, ut{};
+#ifdef _WIN32
+        localtime_s(&lt, &t);
+        gmtime_s(&ut, &t);
+#else
+        localtime_r(&t, &lt);
+        gmtime_r(&t, &ut);
+#endif
+        long long l = DaysFromCivil(lt.tm_year + 1900, lt.tm_mon + 1, lt.tm_mday) * 86400 + lt.tm_hour * 3600 + lt.tm_min * 60 + lt.tm_sec;
+        long long u = DaysFromCivil(ut.tm_year + 1900, ut.tm_mon + 1, ut.tm_mday) * 86400 + ut.tm_hour * 3600 + ut.tm_min * 60 + ut.tm_sec;
+        return (int)(l - u);
+    }
+
+    static void Put2(char* p, unsigned v) { p[0] = (char)('0' + v / 10); p[1] = (char)('0' + v % 10); }
+
+    static void WriteCivil(long long secs, char* out) {
+        long long days = FloorDiv(secs, 86400);
+        unsigned sod = (unsigned)(secs - days * 86400);
+
+        // Inverse of DaysFromCivil
+        long long z = days + 719468;
+        long long era = (z >= 0 ? z : z - 146096) / 146097;
+        unsigned doe = (unsigned)(z - era * 146097);
+        unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        long long y = (long long)yoe + era * 400;
+        unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        unsigned mp = (5 * doy + 2) / 153;
+        unsigned d = doy - (153 * mp + 2) / 5 + 1;
+        unsigned m = mp < 10 ? mp + 3 : mp - 9;
+        y += (m <= 2);
+
+        unsigned yy = (unsigned)(y < 0 ? 0 : (y > 9999 ? 9999 : y));
+        out[0] = (char)('0' + yy / 1000);
+        out[1] = (char)('0' + yy / 100 % 10);
+        Put2(out + 2, yy % 100);
+        out[4] = '-';  Put2(out + 5, m);
+        out[7] = '-';  Put2(out + 8, d);
+        out[10] = ' '; Put2(out + 11, sod / 3600);
+        out[13] = ':'; Put2(out + 14, sod / 60 % 60);
+        out[16] = ':'; Put2(out + 17, sod % 60);
+        out[19] = '\0';
+    }
+};
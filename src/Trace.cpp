@@ -0,0 +1,137 @@
+#include "Trace.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Fields are relaxed atomics so a concurrent Dump() never reads a torn
+// value; the writer publishes each slot by bumping `head` with release.
+struct Event {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<int64_t> startUs{0};
+    std::atomic<int64_t> durUs{0};
+};
+
+struct ThreadBuffer {
+    static constexpr uint64_t Capacity = 1 << 14;
+
+    explicit ThreadBuffer(int id) : tid(id) {}
+
+    const int tid;
+    std::atomic<const char*> threadName{nullptr};
+    std::atomic<uint64_t> head{0};
+    Event events[Capacity];
+};
+
+std::mutex g_registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> g_buffers;
+
+// Buffers are registered once per thread and kept after the thread exits,
+// so events from finished workers still show up in the dump.
+ThreadBuffer& LocalBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        auto b = std::make_shared<ThreadBuffer>((int)g_buffers.size() + 1);
+        g_buffers.push_back(b);
+        return b;
+    }();
+    return *buffer;
+}
+
+int64_t ToUs(Trace::Clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+}
+
+} // namespace
+
+void Trace::Record(const char* name, Clock::time_point start, Clock::time_point end) {
+    ThreadBuffer& b = LocalBuffer();
+    uint64_t h = b.head.load(std::memory_order_relaxed);
+    Event& e = b.events[h % ThreadBuffer::Capacity];
+    e.name.store(name, std::memory_order_relaxed);
+    e.startUs.store(ToUs(start), std::memory_order_relaxed);
+    e.durUs.store(ToUs(end) - ToUs(start), std::memory_order_relaxed);
+    b.head.store(h + 1, std::memory_order_release);
+}
+
+void Trace::RecordWait(const char* name, Clock::time_point start, Clock::time_point end) {
+    Record(name, start, end);
+    // Per-thread handle cache keyed by the literal's address, so only the
+    // first contended wait on each lock takes the metrics registry lock
+    thread_local std::unordered_map<const char*, Metrics::Histogram> histograms;
+    auto it = histograms.find(name);
+    if (it == histograms.end()) {
+        std::string label = name;
+        if (label.compare(0, 5, "wait ") == 0) label.erase(0, 5);
+        auto h = Metrics::GetHistogram("earthquake_mutex_wait_seconds", "Time spent waiting for a contended lock",
+                                       "lock=\"" + label + "\"");
+        it = histograms.emplace(name, h).first;
+    }
+    it->second.Observe(std::chrono::duration<double>(end - start).count());
+}
+
+void Trace::SetThreadName(const char* name) {
+    LocalBuffer().threadName.store(name, std::memory_order_relaxed);
+}
+
+std::string Trace::Dump() {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        buffers = g_buffers;
+    }
+
+    struct Copied { const char* name; int64_t startUs; int64_t durUs; };
+    std::vector<Copied> copied;
+
+    // Names are literals from our own code, so no JSON escaping is needed
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto append = [&](const std::string& s) {
+        if (!first) out += ",";
+        out += s;
+        first = false;
+    };
+
+    for (const auto& b : buffers) {
+        const char* threadName = b->threadName.load(std::memory_order_relaxed);
+        std::string tid = std::to_string(b->tid);
+        append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid +
+               ",\"args\":{\"name\":\"" + (threadName ? threadName : "Thread " + tid) + "\"}}");
+
+        uint64_t end = b->head.load(std::memory_order_acquire);
+        uint64_t begin = end > ThreadBuffer::Capacity ? end - ThreadBuffer::Capacity : 0;
+        copied.clear();
+        for (uint64_t i = begin; i < end; i++) {
+            const Event& e = b->events[i % ThreadBuffer::Capacity];
+            copied.push_back({e.name.load(std::memory_order_relaxed),
+                              e.startUs.load(std::memory_order_relaxed),
+                              e.durUs.load(std::memory_order_relaxed)});
+        }
+
+        // The owner kept writing while we copied; drop slots it may have reused
+        uint64_t after = b->head.load(std::memory_order_acquire);
+        uint64_t firstValid = after > ThreadBuffer::Capacity ? after - ThreadBuffer::Capacity + 1 : 0;
+        for (uint64_t i = std::max(begin, firstValid); i < end; i++) {
+            const Copied& e = copied[i - begin];
+            if (!e.name) continue;
+            append("{\"name\":\"" + std::string(e.name) + "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid +
+                   ",\"ts\":" + std::to_string(e.startUs) + ",\"dur\":" + std::to_string(e.durUs) + "}");
+        }
+    }
+    out += "]}";
+    return out;
+}
+
+bool Trace::DumpToFile(const std::string& path) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    out << Dump();
+    return (bool)out;
+}
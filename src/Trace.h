@@ -0,0 +1,53 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <string>
+
+// In-process timeline tracing. TRACE_SCOPE records a complete event into a
+// ring buffer owned by the calling thread (single writer, no locks on the
+// hot path). Dump() merges every thread's buffer into Chrome trace JSON,
+// which loads in chrome://tracing or ui.perfetto.dev.
+class Trace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // `name` must outlive the trace; pass string literals.
+    static void Record(const char* name, Clock::time_point start, Clock::time_point end);
+
+    // Label the calling thread in the exported timeline (string literal).
+    static void SetThreadName(const char* name);
+
+    static std::string Dump();
+    static bool DumpToFile(const std::string& path);
+
+    // Lock `m`, recording the time spent waiting only when it was contended.
+    template <typename Mutex>
+    static std::unique_lock<Mutex> Lock(Mutex& m, const char* name) {
+        std::unique_lock<Mutex> lock(m, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            auto start = Clock::now();
+            lock.lock();
+            RecordWait(name, start, Clock::now());
+        }
+        return lock;
+    }
+
+    // Record() plus the earthquake_mutex_wait_seconds histogram, labelled
+    // with `name` minus its "wait " prefix.
+    static void RecordWait(const char* name, Clock::time_point start, Clock::time_point end);
+
+    class Scope {
+    public:
+        explicit Scope(const char* name) : m_name(name), m_start(Clock::now()) {}
+        ~Scope() { Record(m_name, m_start, Clock::now()); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        const char* m_name;
+        Clock::time_point m_start;
+    };
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope_, __LINE__)(name)
@@ -0,0 +1,724 @@
+#include "EventStream.h"
+#include "QuakeStats.h"
+#include "QuakeJson.h"
+#include "QuakeIndex.h"
+#include "QuakeAggregates.h"
+#include "QuakeBinary.h"
+#include "Gzip.h"
+#include "Metrics.h"
+#include "RateLimiter.h"
+#include "ResponseCache.h"
+#include "httplib.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Behavioral checks of the core library (run: ctest, or EarthquakeTests
+// directly). Plain asserts that keep going after a failure and report
+// every one; the exit code is non-zero when any check failed.
+
+namespace {
+
+int g_checks = 0;
+int g_failures = 0;
+
+#define CHECK(cond) Check((cond), #cond, __FILE__, __LINE__)
+
+void Check(bool ok, const char* expr, const char* file, int line) {
+    g_checks++;
+    if (ok) return;
+    g_failures++;
+    std::printf("%s:%d: CHECK(%s) failed\n", file, line, expr);
+}
+
+// Small deterministic PRNG, same as the benchmark's
+struct Rng {
+    uint64_t state;
+    explicit Rng(uint64_t seed) : state(seed) {}
+    uint32_t Next() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (uint32_t)(state >> 33);
+    }
+    double Uniform(double lo, double hi) { return lo + (hi - lo) * (Next() / 2147483648.0); }
+};
+
+Earthquake MakeQuake(const std::string& id, double mag, long long timeMs, double lat, double lon, const std::string& place) {
+    Earthquake q;
+    q.id = id;
+    q.mag = mag;
+    q.time_ms = timeMs;
+    q.lat = lat;
+    q.lon = lon;
+    q.place = place;
+    return q;
+}
+
+// Coarse values so ties in time and magnitude are common
+std::vector<Earthquake> RandomQuakes(size_t count, uint64_t seed) {
+    static const char* places[] = {"10 km W of Pahala, Hawaii", "3 km N of Ridgecrest, CA", "south of the Fiji Islands",
+                                   "45 km SE of Hualien, Taiwan", "Kermadec Islands region"};
+    Rng rng(seed);
+    std::vector<Earthquake> quakes;
+    for (size_t i = 0; i < count; i++) {
+        quakes.push_back(MakeQuake("q" + std::to_string(i), (rng.Next() % 80) / 10.0, 1700000000000LL + (rng.Next() % 500) * 60000LL,
+                                   rng.Uniform(-90, 90), rng.Uniform(-180, 180), places[rng.Next() % 5]));
+    }
+    return quakes;
+}
+
+void TestExtractRegion() {
+    CHECK(QuakeStats::ExtractRegion("10 km W of Coquimbo, Chile") == "Chile");
+    CHECK(QuakeStats::ExtractRegion("3 km N of Ridgecrest, CA") == "USA");
+    CHECK(QuakeStats::ExtractRegion("12 km SSE of Ponce, Puerto Rico") == "USA");
+    CHECK(QuakeStats::ExtractRegion("Kermadec Islands region") == "Kermadec Islands");
+    CHECK(QuakeStats::ExtractRegion("south of the Fiji Islands") == "south of the Fiji Islands");
+    CHECK(QuakeStats::ExtractRegion("Off the coast of X, Japan offshore") == "Japan");
+
+    // Malformed places from the feed must not throw on the publish thread
+    CHECK(QuakeStats::ExtractRegion("") == "Unknown");
+    CHECK(QuakeStats::ExtractRegion("   ") == "Unknown");
+    CHECK(QuakeStats::ExtractRegion(",") == "Unknown");
+    CHECK(QuakeStats::ExtractRegion(", ") == "Unknown");
+    CHECK(QuakeStats::ExtractRegion("Banda Sea,") == "Banda Sea");
+    CHECK(QuakeStats::ExtractRegion("Banda Sea, ") == "Banda Sea");
+    CHECK(QuakeStats::ExtractRegion("5 km N of Town,Chile") == "Chile");
+    CHECK(QuakeStats::ExtractRegion("5 km N of Town,   Chile  ") == "Chile");
+}
+
+void TestStats() {
+    CHECK(QuakeStats::ContainsCaseInsensitive("10 km W of Pahala, Hawaii", "HAWAII"));
+    CHECK(QuakeStats::ContainsCaseInsensitive("anything", ""));
+    CHECK(!QuakeStats::ContainsCaseInsensitive("Fiji", "fijis"));
+
+    std::vector<Earthquake> quakes = {MakeQuake("a", 2.5, 0, 0, 0, "X, Chile"), MakeQuake("b", 4.1, 0, 0, 0, "Y, Chile"),
+                                      MakeQuake("c", 9.4, 0, 0, 0, "Z, Peru"), MakeQuake("d", -1.3, 0, 0, 0, "W, CA")};
+    std::vector<std::string> regions;
+    for (const auto& q : quakes) regions.push_back(QuakeStats::ExtractRegion(q.place));
+    auto stats = QuakeStats::ByRegion(quakes, regions);
+    CHECK(stats.size() == 3 && stats[0].name == "Chile" && stats[0].count == 2 && stats[0].maxMag == 4.1);
+    CHECK(stats[1].name == "Peru" && stats[2].name == "USA" && stats[2].count == 1);
+
+    float bins[QuakeStats::HistogramBins];
+    CHECK(QuakeStats::MagnitudeHistogram(quakes, bins) == 1.0f);
+    CHECK(bins[2] == 1 && bins[4] == 1 && bins[9] == 1 && bins[0] == 0);   // negative magnitudes are not binned
+}
+
+void TestJson() {
+    std::string out;
+    QuakeJson::AppendString(out, "a\"b\\c\n\x01");
+    CHECK(out == "\"a\\\"b\\\\c\\n\\u0001\"");
+    out.clear();
+    QuakeJson::AppendNumber(out, std::numeric_limits<double>::infinity());
+    CHECK(out == "null");
+
+    QuakeSnapshot snapshot;
+    snapshot.version = 7;
+    snapshot.quakes = {MakeQuake("a", 3.5, 0, 0, 0, "Near \"Town\"")};
+    CHECK(QuakeJson::Status(snapshot) == "{\"status\": \"running\", \"version\": 7, \"count\": 1, \"latest\": {\"place\": \"Near \\\"Town\\\"\", \"mag\": 3.5}}");
+}
+
+// Incremental totals against a recount of the published snapshot
+void TestAggregates() {
+    EarthquakeService service;
+    std::vector<Earthquake> quakes = RandomQuakes(800, 5);
+    quakes.push_back(MakeQuake("trailing", 2.0, 1700000000000LL, 0, 0, "Banda Sea,"));
+    quakes.push_back(MakeQuake("blank", -0.5, 1700000000000LL, 0, 0, ""));
+    service.publish(quakes);
+
+    Rng rng(9);
+    int mismatches = 0;
+    for (int v = 0; v < 20; v++) {
+        for (size_t i = (size_t)v; i < quakes.size(); i += 23) {
+            quakes[i].mag = (rng.Next() % 95) / 10.0;
+            quakes[i].time_ms += (long long)(rng.Next() % 100000);
+            if (v % 3 == 0) quakes[i].place = "7 km E of Town, Tonga";
+        }
+        if (v % 4 == 1) quakes.erase(quakes.begin() + v, quakes.begin() + v + 30);
+        if (v % 5 == 2) quakes.push_back(MakeQuake("new" + std::to_string(v), 9.7, 1700000000000LL, 0, 0, "Tonga"));
+        service.publish(quakes);
+
+        auto snapshot = service.getSnapshot();
+        const QuakeAggregates& a = *snapshot->aggregates;
+        std::map<std::string, RegionStats> regions;
+        std::array<uint32_t, QuakeAggregates::MagBins> bins{};
+        std::map<long long, uint32_t> minutes;
+        for (const auto& q : snapshot->quakes) {
+            RegionStats& r = regions[QuakeStats::ExtractRegion(q.place)];
+            r.maxMag = r.count ? std::max(r.maxMag, q.mag) : q.mag;
+            r.count++;
+            bins[(size_t)QuakeAggregates::MagBin(q.mag)]++;
+            minutes[q.time_ms / QuakeAggregates::MinuteMs * QuakeAggregates::MinuteMs]++;
+        }
+        bool same = a.total == snapshot->quakes.size() && a.magBins == bins && a.regions.size() == regions.size() &&
+                    a.minutes == std::vector<std::pair<long long, uint32_t>>(minutes.begin(), minutes.end());
+        for (const auto& r : a.regions) {
+            auto it = regions.find(r.name);
+            same = same && it != regions.end() && it->second.count == r.count && it->second.maxMag == r.maxMag;
+        }
+        if (!same) mismatches++;
+    }
+    CHECK(mismatches == 0);
+
+    // Re-binning
+    QuakeAggregator aggregator;
+    QuakeChangeSet changes;
+    changes.inserted = {MakeQuake("a", 1.25, 0, 0, 0, "X, Chile"), MakeQuake("b", 1.9, 59999, 0, 0, "Y, Chile"),
+                        MakeQuake("c", 4.0, 3600000, 0, 0, "Z, Peru")};
+    aggregator.Apply(changes);
+    auto totals = aggregator.Publish();
+    auto half = totals->Histogram(5);
+    CHECK(half.size() == 7 && half[0].min == 1.0 && half[0].count == 1 && half[1].count == 1 && half[6].count == 1);
+    auto top = totals->TopRegions(false, 1);
+    CHECK(top.size() == 1 && top[0].name == "Chile" && top[0].count == 2 && top[0].maxMag == 1.9);
+    CHECK(totals->TopRegions(true, 0).front().name == "Peru");
+    auto hourly = totals->Rate(3600000, 0, 7200000);
+    CHECK(hourly.size() == 2 && hourly[0].count == 2 && hourly[1].startMs == 3600000 && hourly[1].count == 1);
+    CHECK(totals->Rate(3600000, 60000, 7200000).size() == 1);
+    CHECK(totals->RateBuckets(60000, 0, 7200000) == 61);
+
+    changes = QuakeChangeSet();
+    changes.removed = {"b"};
+    changes.updated = {MakeQuake("c", 2.0, 3600000, 0, 0, "Z, Chile")};
+    aggregator.Apply(changes);
+    totals = aggregator.Publish();
+    CHECK(totals->total == 2 && totals->regions.size() == 1 && totals->regions[0].maxMag == 2.0);
+}
+
+void TestQueryParse() {
+    QuakeQuery q;
+    std::string error;
+    CHECK(QuakeQuery::Parse({{"minmag", "2.5"}, {"bbox", "170,-50,-170,-40"}, {"sort", "mag"}, {"limit", "20"}, {"offset", "5"}}, q, error));
+    CHECK(q.minMag == 2.5 && q.hasBox && q.minLon == 170 && q.maxLon == -170);
+    CHECK(q.sort == QuakeQuery::Sort::MagAsc && q.limit == 20 && q.offset == 5);
+
+    QuakeQuery clamped;
+    CHECK(QuakeQuery::Parse({{"limit", "99999999999"}}, clamped, error) && clamped.limit == QuakeQuery::MaxLimit);
+
+    const std::vector<std::map<std::string, std::string>> invalid = {
+        {{"minmag", "abc"}}, {{"minmag", "nan"}}, {{"start", "12x"}}, {{"bbox", "1,2,3"}},
+        {{"lat", "10"}, {"lon", "20"}}, {{"lat", "1"}, {"lon", "1"}, {"radius", "-5"}},
+        {{"sort", "depth"}}, {{"limit", "-1"}}, {{"offset", "-3"}},
+    };
+    for (const auto& params : invalid) {
+        QuakeQuery bad;
+        error.clear();
+        CHECK(!QuakeQuery::Parse(params, bad, error) && !error.empty());
+    }
+
+    // Key: equal for equivalent requests, distinct when the page differs
+    QuakeQuery a, b, c;
+    CHECK(QuakeQuery::Parse({{"minmag", "2.50"}, {"place", "a;b"}}, a, error));
+    CHECK(QuakeQuery::Parse({{"place", "a;b"}, {"minmag", "2.5"}}, b, error));
+    CHECK(QuakeQuery::Parse({{"minmag", "2.5"}, {"place", "a;b"}, {"offset", "1"}}, c, error));
+    CHECK(a.Key() == b.Key());
+    CHECK(a.Key() != c.Key());
+}
+
+// Reference: every event through Matches(), then the documented ordering
+// (magnitude or time, then time, then position) and the page window
+QuakeQueryResult BruteForce(const std::vector<Earthquake>& quakes, const QuakeQuery& q) {
+    std::vector<uint32_t> matches;
+    for (uint32_t i = 0; i < quakes.size(); i++) {
+        if (q.Matches(quakes[i])) matches.push_back(i);
+    }
+    bool byTime = q.sort == QuakeQuery::Sort::TimeAsc || q.sort == QuakeQuery::Sort::TimeDesc;
+    bool descending = q.sort == QuakeQuery::Sort::TimeDesc || q.sort == QuakeQuery::Sort::MagDesc;
+    auto less = [&](uint32_t a, uint32_t b) {
+        if (!byTime && quakes[a].mag != quakes[b].mag) return quakes[a].mag < quakes[b].mag;
+        if (quakes[a].time_ms != quakes[b].time_ms) return quakes[a].time_ms < quakes[b].time_ms;
+        return a < b;
+    };
+    std::sort(matches.begin(), matches.end(), [&](uint32_t a, uint32_t b) { return descending ? less(b, a) : less(a, b); });
+
+    QuakeQueryResult result;
+    result.total = matches.size();
+    for (size_t k = q.offset; k < matches.size() && k < q.offset + q.limit; k++) result.items.push_back(matches[k]);
+    return result;
+}
+
+void TestIndexMatchesBruteForce() {
+    std::vector<Earthquake> quakes = RandomQuakes(3000, 7);
+    QuakeIndex index(quakes);
+    Rng rng(11);
+    static const char* sorts[] = {"time", "-time", "mag", "-mag"};
+    int mismatches = 0;
+    for (int n = 0; n < 400; n++) {
+        std::map<std::string, std::string> params;
+        if (rng.Next() % 2) params["minmag"] = std::to_string((rng.Next() % 60) / 10.0);
+        if (rng.Next() % 3 == 0) params["maxmag"] = std::to_string(3 + (rng.Next() % 50) / 10.0);
+        if (rng.Next() % 3 == 0) params["start"] = std::to_string(1700000000000LL + (rng.Next() % 400) * 60000LL);
+        if (rng.Next() % 3 == 0) params["end"] = std::to_string(1700000000000LL + (rng.Next() % 500) * 60000LL);
+        switch (rng.Next() % 4) {
+            case 0: {   // box, sometimes across the antimeridian
+                double lon0 = rng.Uniform(-180, 180), lat0 = rng.Uniform(-90, 60);
+                double lon1 = lon0 + rng.Uniform(5, 120), lat1 = lat0 + rng.Uniform(5, 30);
+                if (lon1 > 180) lon1 -= 360;
+                params["bbox"] = std::to_string(lon0) + "," + std::to_string(lat0) + "," + std::to_string(lon1) + "," + std::to_string(lat1);
+                break;
+            }
+            case 1:     // radius, sometimes near a pole
+                params["lat"] = std::to_string(rng.Uniform(-89, 89));
+                params["lon"] = std::to_string(rng.Uniform(-180, 180));
+                params["radius"] = std::to_string(rng.Uniform(100, 5000));
+                break;
+            default: break;
+        }
+        if (rng.Next() % 4 == 0) params["place"] = "HAWAII";
+        params["sort"] = sorts[rng.Next() % 4];
+        params["limit"] = std::to_string(rng.Next() % 300);
+        params["offset"] = std::to_string(rng.Next() % 3 ? 0 : rng.Next() % 200);
+
+        QuakeQuery q;
+        std::string error;
+        if (!QuakeQuery::Parse(params, q, error)) { CHECK(false); continue; }
+        QuakeQueryResult expected = BruteForce(quakes, q), actual = index.Query(quakes, q);
+        if (expected.total != actual.total || expected.items != actual.items) mismatches++;
+    }
+    CHECK(mismatches == 0);
+}
+
+void TestResponseCache() {
+    ResponseCache cache;
+    int builds = 0;
+    auto build = [&] { builds++; return CachedResponse{"text/plain", "body"}; };
+    auto first = cache.GetOrBuild("k", build);
+    auto second = cache.GetOrBuild("k", build);
+    CHECK(builds == 1 && first == second && cache.Size() == 1);
+
+    for (size_t i = 0; cache.Size() < ResponseCache::MaxEntries; i++) cache.GetOrBuild("fill" + std::to_string(i), build);
+    auto extra = cache.GetOrBuild("extra", build);
+    CHECK(extra && extra->body == "body" && cache.Size() == ResponseCache::MaxEntries && !cache.Find("extra"));
+
+    // Byte budget: a body that would not fit is served but not kept
+    ResponseCache sized;
+    auto big = [] { return CachedResponse{"text/plain", std::string(ResponseCache::MaxBytes / 2, 'x')}; };
+    CHECK(sized.GetOrBuild("a", big) && sized.Find("a"));
+    CHECK(sized.GetOrBuild("b", big) && !sized.Find("b"));
+    CHECK(sized.GetOrBuild("c", build) && sized.Find("c"));
+    CHECK(sized.Size() == 2 && sized.Bytes() == ResponseCache::MaxBytes / 2 + 2 + 4);
+}
+
+// Net changes between versions, as /quakes/changes reports them
+void TestChangeLogCollapse() {
+    EarthquakeService service;
+    service.setSortByMag(false);
+    Earthquake a = MakeQuake("a", 1.0, 1000, 0, 0, "A"), b = MakeQuake("b", 2.0, 2000, 0, 0, "B");
+    Earthquake c = MakeQuake("c", 3.0, 3000, 0, 0, "C");
+    service.publish({a, b});                                  // v1
+    service.publish({a, b, c});                               // v2: +c
+    service.publish({a, b});                                  // v3: -c
+    Earthquake a2 = a;
+    a2.mag = 1.5;
+    service.publish({a2});                                    // v4: a updated, -b
+    service.publish({a2, b});                                 // v5: +b
+    CHECK(service.getSnapshot()->version == 5);
+
+    QuakeChangeSet changes;
+    CHECK(service.getChangesSince(1, 3, changes));            // c inserted then removed cancels out
+    CHECK(changes.empty());
+
+    CHECK(service.getChangesSince(3, 5, changes));            // b removed then re-inserted is an update
+    CHECK(changes.inserted.empty() && changes.removed.empty());
+    CHECK(changes.updated.size() == 2);
+
+    CHECK(service.getChangesSince(2, 4, changes));
+    CHECK(changes.removed.size() == 2 && changes.updated.size() == 1 && changes.updated[0].mag == 1.5);
+
+    CHECK(service.getChangesSince(5, 5, changes) && changes.empty());
+
+    // Versions that aged out of the log
+    for (size_t v = 0; v <= EarthquakeService::ChangeLogVersions; v++) {
+        a2.mag += 0.1;
+        service.publish({a2, b});
+    }
+    uint64_t version = service.getSnapshot()->version;
+    CHECK(!service.getChangesSince(1, version, changes) && !service.changeLogCovers(1, version));
+    CHECK(service.getChangesSince(version - 10, version, changes) && service.changeLogCovers(version - 10, version));
+    CHECK(!service.changeLogCovers(version + 1, version));
+
+    // Aged-out versions share one cached full body instead of one each
+    const int port = 18396;
+    service.startAPIServer(port);
+    httplib::Client cli("127.0.0.1", port);
+    size_t cached = service.getSnapshot()->responses->Size();
+    auto first = cli.Get("/quakes/changes?since=0");
+    auto second = cli.Get("/quakes/changes?since=2");
+    CHECK(first && first->status == 200 && first->body.find("\"full\":true") != std::string::npos);
+    CHECK(second && first && second->body == first->body && second->get_header_value("ETag") == first->get_header_value("ETag"));
+    CHECK(service.getSnapshot()->responses->Size() == cached + 1);
+    service.stopService();
+}
+
+void TestNegotiation() {
+    using Format = QuakeBinary::Format;
+    CHECK(QuakeBinary::Negotiate("") == Format::Json);
+    CHECK(QuakeBinary::Negotiate("*/*") == Format::Json);
+    CHECK(QuakeBinary::Negotiate("application/cbor") == Format::Cbor);
+    CHECK(QuakeBinary::Negotiate("application/x-msgpack") == Format::MsgPack);
+    CHECK(QuakeBinary::Negotiate("application/cbor;q=0.4, application/msgpack;q=0.5") == Format::MsgPack);
+    CHECK(QuakeBinary::Negotiate("application/cbor, application/json") == Format::Cbor);
+    CHECK(QuakeBinary::Negotiate("application/json, application/cbor;q=0.9") == Format::Json);
+    CHECK(QuakeBinary::Negotiate("application/cbor;q=0") == Format::Json);
+    CHECK(QuakeBinary::Negotiate("text/html, image/png") == Format::Json);
+    CHECK(QuakeBinary::Negotiate("application/cbor;seq=0") == Format::Cbor);      // only "q" is the weight
+    CHECK(QuakeBinary::Negotiate("application/cbor; Q=0.2, application/msgpack;level=1;q=0.1") == Format::Cbor);
+    CHECK(QuakeBinary::Negotiate("application/cbor;q=junk") == Format::Json);
+
+    CHECK(!Gzip::Accepted(""));
+    CHECK(Gzip::Accepted("gzip"));
+    CHECK(Gzip::Accepted("deflate, GZIP;q=0.5"));
+    CHECK(Gzip::Accepted("*"));
+    CHECK(!Gzip::Accepted("gzip;q=0"));
+    CHECK(!Gzip::Accepted("gzip;q=0, *"));
+    CHECK(!Gzip::Accepted("br, deflate"));
+    CHECK(Gzip::Accepted("gzip;xq=0"));
+    CHECK(!Gzip::Accepted("gzip ; q = 0"));
+
+    std::string body(5000, 'x');
+    CHECK(Gzip::Compress(body).size() < body.size());
+}
+
+
+// ETag / If-None-Match end to end through the API server
+void TestConditionalRequests() {
+    const int port = 18391;
+    EarthquakeService service;
+    service.publish(RandomQuakes(500, 3));
+    ApiServerConfig config;
+    config.threads = 2;
+    config.debugTrace = true;
+    service.startAPIServer(port, config);
+
+    httplib::Client cli("127.0.0.1", port);
+    cli.set_decompress(false);
+    auto plain = cli.Get("/quakes?limit=200");
+    CHECK(plain && plain->status == 200);
+    if (!plain) { service.stopService(); return; }
+    std::string etag = plain->get_header_value("ETag");
+    CHECK(!etag.empty());
+
+    auto same = cli.Get("/quakes?limit=200", {{"If-None-Match", etag}});
+    CHECK(same && same->status == 304 && same->body.empty());
+    auto weak = cli.Get("/quakes?limit=200", {{"If-None-Match", "\"other\", W/" + etag}});
+    CHECK(weak && weak->status == 304);
+    auto any = cli.Get("/quakes?limit=200", {{"If-None-Match", "*"}});
+    CHECK(any && any->status == 304);
+    auto stale = cli.Get("/quakes?limit=200", {{"If-None-Match", "\"0-0-0\""}});
+    CHECK(stale && stale->status == 200);
+
+    auto gzip = cli.Get("/quakes?limit=200", {{"Accept-Encoding", "gzip"}});
+    CHECK(gzip && gzip->status == 200 && gzip->get_header_value("Content-Encoding") == "gzip");
+    CHECK(gzip && gzip->get_header_value("ETag") != etag && gzip->body.size() < plain->body.size());
+    auto cbor = cli.Get("/quakes?limit=200", {{"Accept", "application/cbor"}});
+    CHECK(cbor && cbor->get_header_value("Content-Type") == "application/cbor");
+    CHECK(cbor && cbor->get_header_value("ETag") != etag && cbor->get_header_value("Vary") == "Accept, Accept-Encoding");
+
+    // A new version invalidates the tag
+    service.publish(RandomQuakes(400, 4));
+    auto changed = cli.Get("/quakes?limit=200", {{"If-None-Match", etag}});
+    CHECK(changed && changed->status == 200);
+
+    auto bad = cli.Get("/quakes?sort=depth");
+    CHECK(bad && bad->status == 400);
+    auto metrics = cli.Get("/metrics");
+    CHECK(metrics && metrics->get_header_value("Content-Type") == "text/plain; version=0.0.4");
+    CHECK(metrics && metrics->body.find("earthquake_api_responses_total{route=\"/quakes\",code=\"4xx\"} 1\n") != std::string::npos);
+    auto trace = cli.Get("/debug/trace");                    // opted in, and we are on loopback
+    CHECK(trace && trace->status == 200);
+    service.stopService();
+}
+
+// Reads an event stream until `done` holds for what arrived or the read times out
+std::string ReadStream(int port, const std::string& target, const httplib::Headers& headers,
+                       const std::function<bool(const std::string&)>& done, std::function<void(const std::string&)> progress = {}) {
+    httplib::Client cli("127.0.0.1", port);
+    cli.set_read_timeout(3, 0);
+    std::string body;
+    cli.Get(target, headers, [&](const char* data, size_t len) {
+        body.append(data, len);
+        if (progress) progress(body);
+        return !done(body);
+    });
+    return body;
+}
+
+// Live push, per-client filters, Last-Event-ID replay and reset
+void TestEventStream() {
+    const int port = 18393;
+    EventStreamServer stream;
+    if (!stream.start(port)) { CHECK(false); return; }
+
+    // An unknown id resets; that also tells us the client is streaming
+    std::mutex mutex;
+    std::string seen;
+    std::thread live([&] {
+        ReadStream(port, "/events/stream?minmag=3&lastEventId=1", {},
+                   [](const std::string& b) { return b.find("event: update") != std::string::npos; },
+                   [&](const std::string& b) { std::lock_guard<std::mutex> lock(mutex); seen = b; });
+    });
+    auto streaming = [&] { std::lock_guard<std::mutex> lock(mutex); return seen.find("event: reset") != std::string::npos; };
+    for (int i = 0; i < 500 && !streaming(); i++) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(streaming());
+
+    auto v1 = std::make_shared<QuakeSnapshot>();
+    v1->version = 1;
+    v1->changes.inserted = {MakeQuake("small", 2.0, 1000, 0, 0, "A"), MakeQuake("big", 4.5, 2000, 0, 0, "B")};
+    auto v2 = std::make_shared<QuakeSnapshot>();
+    v2->version = 2;
+    v2->changes.updated = {MakeQuake("small", 5.0, 1000, 0, 0, "A")};
+    stream.publish(v1);
+    stream.publish(v2);
+    live.join();
+
+    std::string body = seen;
+    CHECK(body.find("\"id\":\"big\"") != std::string::npos);
+    CHECK(body.find("event: insert\ndata: {\"version\":1,\"quake\":{\"id\":\"small\"") == std::string::npos);   // filtered out
+    size_t idPos = body.find("id: ");
+    CHECK(idPos != std::string::npos);
+    if (idPos == std::string::npos) { stream.stop(); return; }
+    std::string bigId = body.substr(idPos + 4, body.find('\n', idPos) - idPos - 4);
+
+    // Resume after "big": only the later update is replayed, no reset
+    std::string resumed = ReadStream(port, "/events/stream?minmag=3", {{"Last-Event-ID", bigId}},
+                                     [](const std::string& b) { return b.find("event: update") != std::string::npos; });
+    CHECK(resumed.find("event: update") != std::string::npos && resumed.find("\"mag\":5") != std::string::npos);
+    CHECK(resumed.find("event: insert") == std::string::npos && resumed.find("event: reset") == std::string::npos);
+
+    std::string reset = ReadStream(port, "/events/stream", {{"Last-Event-ID", "12x"}},
+                                   [](const std::string& b) { return b.find("event: reset") != std::string::npos; });
+    CHECK(reset.find("event: reset\ndata: {\"version\":2}") != std::string::npos);
+    stream.stop();
+}
+
+std::string Gunzip(const std::string& data) {
+    z_stream zs{};
+    if (inflateInit2(&zs, 15 + 16) != Z_OK) return "";
+    zs.next_in = (Bytef*)data.data();
+    zs.avail_in = (uInt)data.size();
+    std::string out;
+    char buf[16384];
+    int rc = Z_OK;
+    while (rc == Z_OK) {
+        zs.next_out = (Bytef*)buf;
+        zs.avail_out = sizeof(buf);
+        rc = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    }
+    inflateEnd(&zs);
+    return rc == Z_STREAM_END ? out : "";
+}
+
+// Pages past StreamThreshold go out chunked, plain or gzipped, and must
+// match the body the cached path would have built
+void TestStreamedPages() {
+    const int port = 18394;
+    EarthquakeService service;
+    service.publish(RandomQuakes(5000, 6));
+    service.startAPIServer(port);
+
+    auto snapshot = service.getSnapshot();
+    QuakeQuery query;
+    std::string error;
+    CHECK(QuakeQuery::Parse({{"limit", "4500"}, {"sort", "mag"}}, query, error));
+    std::string expected = QuakeJson::QueryResult(*snapshot, snapshot->index->Query(snapshot->quakes, query), query);
+
+    httplib::Client cli("127.0.0.1", port);
+    cli.set_decompress(false);
+    auto plain = cli.Get("/quakes?limit=4500&sort=mag");
+    CHECK(plain && plain->status == 200 && plain->get_header_value("Transfer-Encoding") == "chunked");
+    CHECK(plain && plain->body == expected);
+
+    auto gzip = cli.Get("/quakes?limit=4500&sort=mag", {{"Accept-Encoding", "gzip"}});
+    CHECK(gzip && gzip->get_header_value("Content-Encoding") == "gzip" && gzip->get_header_value("Transfer-Encoding") == "chunked");
+    CHECK(gzip && gzip->body.size() < expected.size() && Gunzip(gzip->body) == expected);
+
+    std::string etag = plain ? plain->get_header_value("ETag") : "";
+    auto same = cli.Get("/quakes?limit=4500&sort=mag", {{"If-None-Match", etag}});
+    CHECK(!etag.empty() && same && same->status == 304);
+
+    // Binary encodings of export-sized pages are built per request, not cached
+    size_t cached = snapshot->responses->Size();
+    auto cbor = cli.Get("/quakes?limit=4500&sort=mag", {{"Accept", "application/cbor"}, {"Accept-Encoding", "gzip"}});
+    CHECK(cbor && cbor->status == 200 && cbor->get_header_value("Content-Type") == "application/cbor");
+    CHECK(cbor && cbor->get_header_value("Content-Encoding") == "gzip" && !Gunzip(cbor->body).empty());
+    CHECK(snapshot->responses->Size() == cached);
+
+    auto small = cli.Get("/quakes?limit=100");
+    CHECK(small && small->has_header("Content-Length") && !small->has_header("Transfer-Encoding"));
+    auto trace = cli.Get("/debug/trace");                    // off unless configured
+    CHECK(trace && trace->status == 404);
+    service.stopService();
+}
+
+void TestRateLimiter() {
+    ClientRateLimiter limiter(1, 3);
+    CHECK(limiter.Acquire("10.0.0.1") == 0);
+    CHECK(limiter.Acquire("10.0.0.1") == 0);
+    CHECK(limiter.Acquire("10.0.0.1") == 0);
+    int64_t wait = limiter.Acquire("10.0.0.1");
+    CHECK(wait > 0 && wait <= 1001);   // ms to the next token, rounded up
+    CHECK(limiter.Acquire("10.0.0.2") == 0);                  // buckets are per client
+
+    ClientRateLimiter fast(1000, 1);
+    CHECK(fast.Acquire("c") == 0);
+    CHECK(fast.Acquire("c") > 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    CHECK(fast.Acquire("c") == 0);                            // refilled
+
+    // Through the server: 429 with Retry-After past the burst, priority routes exempt
+    ApiServerConfig config;
+    config.threads = 1;
+    config.clientRate = 1;
+    config.clientBurst = 2;
+    ApiServer server(config);
+    auto ok = [](const httplib::Request&, httplib::Response& res) { res.set_content("{}", "application/json"); };
+    server.Get("/limited", ok);
+    server.Get("/status", ok);
+    CHECK(server.start(18395));
+    httplib::Client cli("127.0.0.1", 18395);
+    int limited = 0;
+    for (int i = 0; i < 4; i++) {
+        auto res = cli.Get("/limited");
+        if (res && res->status == 429 && !res->get_header_value("Retry-After").empty()) limited++;
+    }
+    CHECK(limited == 2);
+    auto status = cli.Get("/status");
+    CHECK(status && status->status == 200);
+    server.stop();
+}
+
+#ifndef _WIN32
+// A client that connects and never sends a request
+int ConnectIdle(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Idle connections hold the worker, the queue and the overflow lane of the
+// main port for their read timeout; /status on the admin port is answered
+// at once all the same
+void TestPriorityIsolation() {
+    ApiServerConfig config;
+    config.threads = 1;
+    config.maxQueued = 1;
+    config.adminPort = 18398;
+    ApiServer server(config);
+    auto ok = [](const httplib::Request&, httplib::Response& res) { res.set_content("{}", "application/json"); };
+    server.Get("/quakes", ok);
+    server.Get("/status", ok);
+    CHECK(server.start(18397));
+
+    std::vector<int> idle;
+    for (int i = 0; i < 6; i++) idle.push_back(ConnectIdle(18397));   // worker, queue, 4 overflow
+    CHECK(std::count(idle.begin(), idle.end(), -1) == 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto start = std::chrono::steady_clock::now();
+    httplib::Client admin("127.0.0.1", 18398);
+    auto status = admin.Get("/status");
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(status && status->status == 200);
+    CHECK(ms < 500);
+    auto quakes = admin.Get("/quakes");                       // only priority routes on the admin port
+    CHECK(quakes && quakes->status == 404);
+
+    for (int fd : idle) if (fd >= 0) close(fd);
+    server.stop();
+}
+#endif
+
+// stop() right after start() must not hang on a listener that is not up yet
+void TestStartStop() {
+    for (int i = 0; i < 20; i++) {
+        ApiServerConfig config;
+        config.threads = 1;
+        ApiServer server(config);
+        server.Get("/status", [](const httplib::Request&, httplib::Response& res) { res.set_content("{}", "application/json"); });
+        CHECK(server.start(18392));
+        server.stop();
+    }
+}
+
+// Shards summed across threads, one HELP/TYPE per name, cumulative buckets
+void TestMetricsExpose() {
+    auto a = Metrics::GetCounter("test_events_total", "Events seen by the test.", "kind=\"a\"");
+    auto b = Metrics::GetCounter("test_events_total", "Events seen by the test.", "kind=\"b\"");
+    std::thread t1([&] { for (int i = 0; i < 1000; i++) a.Add(); });
+    std::thread t2([&] { for (int i = 0; i < 1000; i++) a.Add(); });
+    t1.join();
+    t2.join();
+    b.Add(3);
+    Metrics::GetCounter("test_events_total", "Events seen by the test.", "kind=\"a\"").Add();   // same series
+
+    auto h = Metrics::GetHistogram("test_latency_seconds", "Latency seen by the test.");
+    h.Observe(0.00003);
+    h.Observe(0.3);
+    h.Observe(20);
+    Metrics::GetGauge("test_level", "Level seen by the test.").Set(42);
+
+    std::string text = Metrics::Expose();
+    auto has = [&](const std::string& s) { return text.find(s) != std::string::npos; };
+    CHECK(has("# HELP test_events_total Events seen by the test.\n# TYPE test_events_total counter\n"
+              "test_events_total{kind=\"a\"} 2001\ntest_events_total{kind=\"b\"} 3\n"));
+    CHECK(text.find("# TYPE test_events_total") == text.rfind("# TYPE test_events_total"));
+    CHECK(has("# TYPE test_latency_seconds histogram\ntest_latency_seconds_bucket{le=\"5e-05\"} 1\n"));
+    CHECK(has("test_latency_seconds_bucket{le=\"0.25\"} 1\ntest_latency_seconds_bucket{le=\"0.5\"} 2\n"));
+    CHECK(has("test_latency_seconds_bucket{le=\"10\"} 2\ntest_latency_seconds_bucket{le=\"+Inf\"} 3\n"));
+    CHECK(has("test_latency_seconds_sum 20.30003\ntest_latency_seconds_count 3\n"));
+    CHECK(has("# TYPE test_level gauge\ntest_level 42\n"));
+}
+
+} // namespace
+
+int main() {
+    const std::pair<const char*, std::function<void()>> tests[] = {
+        {"ExtractRegion", TestExtractRegion},
+        {"QuakeStats", TestStats},
+        {"QuakeJson", TestJson},
+        {"QuakeQuery::Parse", TestQueryParse},
+        {"QuakeIndex vs brute force", TestIndexMatchesBruteForce},
+        {"ResponseCache", TestResponseCache},
+        {"change log collapse", TestChangeLogCollapse},
+        {"aggregates", TestAggregates},
+        {"Accept / Accept-Encoding", TestNegotiation},
+        {"ClientRateLimiter", TestRateLimiter},
+        {"Metrics::Expose", TestMetricsExpose},
+        {"ApiServer start / stop", TestStartStop},
+#ifndef _WIN32
+        {"priority routes isolated", TestPriorityIsolation},
+#endif
+        {"ETag / If-None-Match", TestConditionalRequests},
+        {"streamed /quakes pages", TestStreamedPages},
+        {"event stream resume", TestEventStream},
+    };
+    for (const auto& [name, run] : tests) {
+        int before = g_failures;
+        run();
+        std::printf("%-28s %s\n", name, g_failures == before ? "ok" : "FAILED");
+    }
+    std::printf("%d checks, %d failed\n", g_checks, g_failures);
+    return g_failures ? 1 : 0;
+}